@@ -0,0 +1,144 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *   (for jsdoc)
+ *   @copyright 2013 Couchbase, Inc.
+ */
+
+/**
+ * Garbage collection cost of a steady stream of single-key gets, each of
+ * which returns a CAS object. Gets are issued at a fixed rate rather than
+ * as fast as possible, so that runs of different builds do the same
+ * amount of work and their GC figures can be compared directly:
+ *
+ *   node --expose-gc benchmarks/gcpause.js [ops/s] [seconds] [host:port]
+ *
+ * The rate defaults to 100000 and the duration to 10 seconds. As with
+ * suite.js, the in-process mock server is used unless a host is given.
+ * The result is printed to stdout as a JSON document.
+ */
+
+var couchbase = require("../lib/couchbase.js");
+var childProcess = require("child_process");
+var path = require("path");
+
+var config = {
+    rate: parseInt(process.argv[2], 10) || 100000,
+    duration: (parseInt(process.argv[3], 10) || 10) * 1000,
+    host: process.argv[4],
+
+    // Gets issued per tick; the rate is reached by spacing the ticks
+    tickInterval: 10,
+    keySpace: 1000
+};
+
+var keyBase = "gcpause_PID[" + process.pid + "]#";
+
+function run(cb, done) {
+    var perTick = Math.max(1, Math.round(
+        config.rate * config.tickInterval / 1000));
+    var issued = 0;
+    var completed = 0;
+    var stopping = false;
+    var start;
+    var timer;
+
+    function onGet() {
+        completed++;
+        if (stopping && completed === issued) {
+            finish();
+        }
+    }
+
+    function tick() {
+        for (var ii = 0; ii < perTick; ii++) {
+            cb.get(keyBase + (issued % config.keySpace), onGet);
+            issued++;
+        }
+    }
+
+    function finish() {
+        var elapsed = process.hrtime(start);
+        var seconds = elapsed[0] + elapsed[1] / 1e9;
+        var gc = cb.gcStats(true);
+
+        done({
+            node: process.version,
+            host: config.host || "mock",
+            targetRate: config.rate,
+            actualRate: completed / seconds,
+            seconds: seconds,
+            ops: completed,
+            gc: gc,
+            pauseMsPerSecond: gc.pauseMs / seconds,
+            latency: cb.latencyStats(true).get
+        });
+    }
+
+    var kv = {};
+    for (var ii = 0; ii < config.keySpace; ii++) {
+        kv[keyBase + ii] = { value: { index: ii } };
+    }
+
+    cb.setMulti(kv, null, function() {
+        if (global.gc) {
+            global.gc();
+        }
+
+        cb.latencyStats(true);
+        cb.gcStats(true);
+        start = process.hrtime();
+
+        timer = setInterval(tick, config.tickInterval);
+        setTimeout(function() {
+            stopping = true;
+            clearInterval(timer);
+            if (completed === issued) {
+                finish();
+            }
+        }, config.duration);
+    });
+}
+
+function main(host, done) {
+    var cb = new couchbase.Connection({
+        host: host,
+        bucket: "default"
+    }, function(err) {
+        if (err) {
+            console.error("Failed to connect to " + host + ": " + err);
+            return done(1);
+        }
+
+        cb.latencyTracking = true;
+        run(cb, function(result) {
+            console.log(JSON.stringify(result, null, 2));
+            cb.shutdown();
+            done(0);
+        });
+    });
+}
+
+if (config.host) {
+    main(config.host, function(rc) { process.exit(rc); });
+} else {
+    var mock = childProcess.fork(path.join(__dirname, "mockserver.js"));
+    mock.on("message", function(msg) {
+        main("127.0.0.1:" + msg.port, function(rc) {
+            mock.kill();
+            process.exit(rc);
+        });
+    });
+}
@@ -0,0 +1,467 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *   (for jsdoc)
+ *   @copyright 2013 Couchbase, Inc.
+ */
+
+/**
+ * A minimal single-node Couchbase bucket, good enough to drive the client
+ * through its data paths without a real cluster. It serves the streaming
+ * bucket configuration over HTTP and speaks the memcached binary protocol
+ * for the commands issued by the client. Everything is kept in memory and
+ * nothing ever expires.
+ *
+ * It is normally forked by suite.js so that the server does not compete
+ * with the client for its event loop; once listening it sends
+ * { port: <http port> } to its parent. It may also be run directly:
+ *
+ *   node benchmarks/mockserver.js [http port] [memcached port]
+ */
+
+var http = require("http");
+var net = require("net");
+
+var NUM_VBUCKETS = 64;
+
+var REQ_MAGIC = 0x80;
+var RES_MAGIC = 0x81;
+var HEADER_LEN = 24;
+
+var opcodes = {
+    GET: 0x00,
+    SET: 0x01,
+    ADD: 0x02,
+    REPLACE: 0x03,
+    DELETE: 0x04,
+    INCREMENT: 0x05,
+    DECREMENT: 0x06,
+    QUIT: 0x07,
+    FLUSH: 0x08,
+    GETQ: 0x09,
+    NOOP: 0x0a,
+    VERSION: 0x0b,
+    GETK: 0x0c,
+    GETKQ: 0x0d,
+    APPEND: 0x0e,
+    PREPEND: 0x0f,
+    STAT: 0x10,
+    TOUCH: 0x1c,
+    GAT: 0x1d,
+    SASL_LIST_MECHS: 0x20,
+    SASL_AUTH: 0x21,
+    OBSERVE: 0x92,
+    GET_LOCKED: 0x94,
+    UNLOCK_KEY: 0x95
+};
+
+var status = {
+    SUCCESS: 0x00,
+    KEY_ENOENT: 0x01,
+    KEY_EEXISTS: 0x02,
+    NOT_STORED: 0x05,
+    DELTA_BADVAL: 0x06,
+    UNKNOWN_COMMAND: 0x81,
+    ETMPFAIL: 0x86
+};
+
+function MockBucket() {
+    this.items = {};
+    this.casCounter = 0;
+}
+
+MockBucket.prototype.nextCas = function() {
+    return ++this.casCounter;
+};
+
+MockBucket.prototype.isLocked = function(item) {
+    return item && item.lockedUntil && item.lockedUntil > Date.now();
+};
+
+function writeCas(buf, offset, cas) {
+    buf.writeUInt32BE(Math.floor(cas / 0x100000000), offset);
+    buf.writeUInt32BE(cas % 0x100000000, offset + 4);
+}
+
+function readCas(buf, offset) {
+    return buf.readUInt32BE(offset) * 0x100000000 +
+        buf.readUInt32BE(offset + 4);
+}
+
+function makeResponse(req, st, extras, key, value, cas) {
+    extras = extras || new Buffer(0);
+    key = key || new Buffer(0);
+    value = value || new Buffer(0);
+
+    var bodylen = extras.length + key.length + value.length;
+    var buf = new Buffer(HEADER_LEN + bodylen);
+
+    buf[0] = RES_MAGIC;
+    buf[1] = req.opcode;
+    buf.writeUInt16BE(key.length, 2);
+    buf[4] = extras.length;
+    buf[5] = 0;
+    buf.writeUInt16BE(st, 6);
+    buf.writeUInt32BE(bodylen, 8);
+    req.opaque.copy(buf, 12);
+    writeCas(buf, 16, cas || 0);
+
+    extras.copy(buf, HEADER_LEN);
+    key.copy(buf, HEADER_LEN + extras.length);
+    value.copy(buf, HEADER_LEN + extras.length + key.length);
+    return buf;
+}
+
+function handleRequest(bucket, req) {
+    var items = bucket.items;
+    var skey = req.key.toString("binary");
+    var item = items[skey];
+    var extras, cas;
+
+    switch (req.opcode) {
+    case opcodes.GET:
+    case opcodes.GETQ:
+    case opcodes.GETK:
+    case opcodes.GETKQ:
+    case opcodes.GAT:
+    case opcodes.GET_LOCKED: {
+        var quiet = req.opcode === opcodes.GETQ ||
+            req.opcode === opcodes.GETKQ;
+        var withKey = req.opcode === opcodes.GETK ||
+            req.opcode === opcodes.GETKQ;
+
+        if (!item) {
+            return quiet ? null : makeResponse(req, status.KEY_ENOENT);
+        }
+        if (req.opcode === opcodes.GET_LOCKED) {
+            if (bucket.isLocked(item)) {
+                return makeResponse(req, status.ETMPFAIL);
+            }
+            var lockTime = req.extras.length ?
+                req.extras.readUInt32BE(0) : 15;
+            item.lockedUntil = Date.now() + (lockTime || 15) * 1000;
+            item.cas = bucket.nextCas();
+        }
+        extras = new Buffer(4);
+        extras.writeUInt32BE(item.flags, 0);
+        return makeResponse(req, status.SUCCESS, extras,
+                            withKey ? req.key : null, item.value, item.cas);
+    }
+
+    case opcodes.SET:
+    case opcodes.ADD:
+    case opcodes.REPLACE: {
+        if (req.opcode === opcodes.ADD && item) {
+            return makeResponse(req, status.KEY_EEXISTS);
+        }
+        if (req.opcode === opcodes.REPLACE && !item) {
+            return makeResponse(req, status.KEY_ENOENT);
+        }
+        if (item && bucket.isLocked(item) && req.cas !== item.cas) {
+            return makeResponse(req, status.ETMPFAIL);
+        }
+        if (req.cas) {
+            if (!item) {
+                return makeResponse(req, status.KEY_ENOENT);
+            } else if (req.cas !== item.cas) {
+                return makeResponse(req, status.KEY_EEXISTS);
+            }
+        }
+
+        cas = bucket.nextCas();
+        items[skey] = {
+            value: req.value,
+            flags: req.extras.length >= 4 ? req.extras.readUInt32BE(0) : 0,
+            cas: cas
+        };
+        return makeResponse(req, status.SUCCESS, null, null, null, cas);
+    }
+
+    case opcodes.APPEND:
+    case opcodes.PREPEND: {
+        if (!item) {
+            return makeResponse(req, status.NOT_STORED);
+        }
+        if (req.cas && req.cas !== item.cas) {
+            return makeResponse(req, status.KEY_EEXISTS);
+        }
+        item.value = req.opcode === opcodes.APPEND ?
+            Buffer.concat([item.value, req.value]) :
+            Buffer.concat([req.value, item.value]);
+        item.cas = bucket.nextCas();
+        return makeResponse(req, status.SUCCESS, null, null, null, item.cas);
+    }
+
+    case opcodes.DELETE: {
+        if (!item) {
+            return makeResponse(req, status.KEY_ENOENT);
+        }
+        if (req.cas && req.cas !== item.cas) {
+            return makeResponse(req, status.KEY_EEXISTS);
+        }
+        delete items[skey];
+        return makeResponse(req, status.SUCCESS, null, null, null,
+                            bucket.nextCas());
+    }
+
+    case opcodes.INCREMENT:
+    case opcodes.DECREMENT: {
+        var delta = readCas(req.extras, 0);
+        var initial = readCas(req.extras, 8);
+        var exptime = req.extras.readUInt32BE(16);
+        var cur;
+
+        if (!item) {
+            if (exptime === 0xffffffff) {
+                return makeResponse(req, status.KEY_ENOENT);
+            }
+            cur = initial;
+        } else {
+            cur = parseInt(item.value.toString(), 10);
+            if (isNaN(cur)) {
+                return makeResponse(req, status.DELTA_BADVAL);
+            }
+            if (req.opcode === opcodes.INCREMENT) {
+                cur += delta;
+            } else {
+                cur = Math.max(0, cur - delta);
+            }
+        }
+
+        cas = bucket.nextCas();
+        items[skey] = {
+            value: new Buffer(String(cur)),
+            flags: item ? item.flags : 0,
+            cas: cas
+        };
+
+        var result = new Buffer(8);
+        writeCas(result, 0, cur);
+        return makeResponse(req, status.SUCCESS, null, null, result, cas);
+    }
+
+    case opcodes.TOUCH:
+        if (!item) {
+            return makeResponse(req, status.KEY_ENOENT);
+        }
+        return makeResponse(req, status.SUCCESS, null, null, null, item.cas);
+
+    case opcodes.UNLOCK_KEY:
+        if (!item) {
+            return makeResponse(req, status.KEY_ENOENT);
+        }
+        if (!bucket.isLocked(item) || req.cas !== item.cas) {
+            return makeResponse(req, status.ETMPFAIL);
+        }
+        delete item.lockedUntil;
+        return makeResponse(req, status.SUCCESS);
+
+    case opcodes.OBSERVE: {
+        // Body: (vbucket, keylen, key)*. Every item is always reported as
+        // persisted, since the mock has no notion of a disk queue
+        var out = [];
+        var off = 0;
+        while (off + 4 <= req.value.length) {
+            var vb = req.value.readUInt16BE(off);
+            var nkey = req.value.readUInt16BE(off + 2);
+            var okey = req.value.slice(off + 4, off + 4 + nkey);
+            var oitem = items[okey.toString("binary")];
+            var entry = new Buffer(4 + nkey + 9);
+
+            entry.writeUInt16BE(vb, 0);
+            entry.writeUInt16BE(nkey, 2);
+            okey.copy(entry, 4);
+            entry[4 + nkey] = oitem ? 0x01 : 0x80;
+            writeCas(entry, 5 + nkey, oitem ? oitem.cas : 0);
+            out.push(entry);
+            off += 4 + nkey;
+        }
+
+        // The CAS field carries the persistence and replication times
+        return makeResponse(req, status.SUCCESS, null, null,
+                            Buffer.concat(out), 0);
+    }
+
+    case opcodes.FLUSH:
+        bucket.items = {};
+        return makeResponse(req, status.SUCCESS);
+
+    case opcodes.NOOP:
+    case opcodes.SASL_AUTH:
+        return makeResponse(req, status.SUCCESS);
+
+    case opcodes.SASL_LIST_MECHS:
+        return makeResponse(req, status.SUCCESS, null, null,
+                            new Buffer("PLAIN"));
+
+    case opcodes.VERSION:
+        return makeResponse(req, status.SUCCESS, null, null,
+                            new Buffer("2.0.0-mock"));
+
+    case opcodes.STAT:
+        // A single empty entry terminates the stats stream
+        return makeResponse(req, status.SUCCESS);
+
+    default:
+        return makeResponse(req, status.UNKNOWN_COMMAND);
+    }
+}
+
+function handleConnection(bucket, sock) {
+    var pending = new Buffer(0);
+
+    sock.setNoDelay(true);
+    sock.on("error", function() {});
+    sock.on("data", function(data) {
+        pending = pending.length ? Buffer.concat([pending, data]) : data;
+
+        var out = [];
+        var off = 0;
+        while (pending.length - off >= HEADER_LEN) {
+            if (pending[off] !== REQ_MAGIC) {
+                sock.destroy();
+                return;
+            }
+
+            var bodylen = pending.readUInt32BE(off + 8);
+            if (pending.length - off < HEADER_LEN + bodylen) {
+                break;
+            }
+
+            var nkey = pending.readUInt16BE(off + 2);
+            var nextras = pending[off + 4];
+            var body = off + HEADER_LEN;
+            var req = {
+                opcode: pending[off + 1],
+                opaque: pending.slice(off + 12, off + 16),
+                cas: readCas(pending, off + 16),
+                extras: pending.slice(body, body + nextras),
+                key: pending.slice(body + nextras, body + nextras + nkey),
+                // Copied, since stored values outlive the read buffer
+                value: new Buffer(bodylen - nextras - nkey)
+            };
+            pending.copy(req.value, 0, body + nextras + nkey,
+                         body + bodylen);
+            off += HEADER_LEN + bodylen;
+
+            if (req.opcode === opcodes.QUIT) {
+                sock.end();
+                return;
+            }
+
+            var res = handleRequest(bucket, req);
+            if (res) {
+                out.push(res);
+            }
+        }
+
+        pending = pending.slice(off);
+        if (out.length) {
+            sock.write(out.length === 1 ? out[0] : Buffer.concat(out));
+        }
+    });
+}
+
+function makeConfig(bucketName, host, memdPort, httpPort) {
+    var vbmap = [];
+    for (var ii = 0; ii < NUM_VBUCKETS; ii++) {
+        vbmap.push([0]);
+    }
+
+    return {
+        name: bucketName,
+        bucketType: "membase",
+        nodeLocator: "vbucket",
+        nodes: [{
+            hostname: host + ":" + httpPort,
+            ports: { direct: memdPort }
+        }],
+        vBucketServerMap: {
+            hashAlgorithm: "CRC",
+            numReplicas: 0,
+            serverList: [ host + ":" + memdPort ],
+            vBucketMap: vbmap
+        }
+    };
+}
+
+/**
+ * Start the mock server.
+ *
+ * @param {Object} options may contain <code>httpPort</code> and
+ *  <code>memcachedPort</code>; both default to an ephemeral port
+ * @param {function(Error, Object)} callback invoked with the ports in use
+ */
+function start(options, callback) {
+    var bucket = new MockBucket();
+    var host = "127.0.0.1";
+    var memd = net.createServer(function(sock) {
+        handleConnection(bucket, sock);
+    });
+
+    memd.on("error", callback);
+    memd.listen(options.memcachedPort || 0, host, function() {
+        var memdPort = memd.address().port;
+        var rest = http.createServer(function(req, res) {
+            var match = /^\/pools\/default\/bucketsStreaming\/([^\/?]+)/
+                .exec(req.url);
+            if (!match) {
+                res.writeHead(404);
+                res.end();
+                return;
+            }
+
+            var config = makeConfig(decodeURIComponent(match[1]), host,
+                                    memdPort, rest.address().port);
+            // Keep the stream open; the client treats it as its source of
+            // configuration updates
+            res.writeHead(200, { "Content-Type": "application/json" });
+            res.write(JSON.stringify(config) + "\n\n\n\n");
+        });
+
+        rest.on("error", callback);
+        rest.listen(options.httpPort || 0, host, function() {
+            callback(null, {
+                port: rest.address().port,
+                memcachedPort: memdPort,
+                close: function() {
+                    rest.close();
+                    memd.close();
+                }
+            });
+        });
+    });
+}
+
+module.exports.start = start;
+
+if (require.main === module) {
+    start({
+        httpPort: parseInt(process.argv[2], 10) || 0,
+        memcachedPort: parseInt(process.argv[3], 10) || 0
+    }, function(err, info) {
+        if (err) {
+            console.error(err);
+            process.exit(1);
+        }
+
+        if (process.send) {
+            process.send({ port: info.port });
+        } else {
+            console.log("Listening on 127.0.0.1:" + info.port +
+                        " (memcached port " + info.memcachedPort + ")");
+        }
+    });
+}
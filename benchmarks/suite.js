@@ -0,0 +1,300 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *   (for jsdoc)
+ *   @copyright 2013 Couchbase, Inc.
+ */
+
+/**
+ * Reproducible benchmark of the *Multi operations. Every operation is run
+ * for a fixed duration at each combination of concurrency and value size
+ * below, and the results are printed to stdout as a single JSON document
+ * so that runs can be diffed or fed to other tools.
+ *
+ * By default the client talks to the in-process mock server (forked from
+ * mockserver.js), which isolates the cost of the binding itself. Pass a
+ * host to run against a real cluster instead:
+ *
+ *   node benchmarks/suite.js [host:port] [bucket]
+ *
+ * Latencies come from the native per-operation histograms and GC figures
+ * from the native GC counters, so the harness itself adds no timing code
+ * to the measured path.
+ */
+
+var couchbase = require("../lib/couchbase.js");
+var childProcess = require("child_process");
+var path = require("path");
+
+// Configuration
+
+var suiteConfig = {
+    // Number of *Multi calls kept in flight at once
+    concurrency: [ 1, 16 ],
+
+    // Value sizes, in bytes
+    valueSizes: [ 32, 1024, 16384 ],
+
+    // Keys per *Multi call
+    batchSize: 100,
+
+    // Duration of each run, in milliseconds
+    duration: 2000,
+
+    // Number of distinct keys each run cycles through
+    keySpace: 10000,
+
+    host: process.argv[2],
+    bucket: process.argv[3] || "default"
+};
+
+var keyBase = "suite_PID[" + process.pid + "]#";
+
+function makeKeys(start, count) {
+    var ret = [];
+    for (var ii = 0; ii < count; ii++) {
+        ret.push(keyBase + ((start + ii) % suiteConfig.keySpace));
+    }
+    return ret;
+}
+
+function makeKv(keys, value) {
+    var ret = {};
+    for (var ii = 0; ii < keys.length; ii++) {
+        ret[keys[ii]] = { value: value };
+    }
+    return ret;
+}
+
+function makeValue(size) {
+    var ret = "";
+    while (ret.length < size) {
+        ret += "abcdefghijklmnopqrstuvwxyz0123456789";
+    }
+    return ret.substr(0, size);
+}
+
+/**
+ * Each workload is invoked with the connection, the keys of one batch and
+ * the value for the current run, and calls done(err, results) once.
+ * Errors from individual keys (e.g. a failed add) are counted but do not
+ * stop the run.
+ */
+var workloads = {
+    setMulti: function(cb, keys, value, done) {
+        cb.setMulti(makeKv(keys, value), null, done);
+    },
+    addMulti: function(cb, keys, value, done) {
+        cb.addMulti(makeKv(keys, value), null, done);
+    },
+    replaceMulti: function(cb, keys, value, done) {
+        cb.replaceMulti(makeKv(keys, value), null, done);
+    },
+    appendMulti: function(cb, keys, value, done) {
+        // Reset the values so that appends do not grow without bound
+        cb.setMulti(makeKv(keys, "a"), null, function() {
+            cb.appendMulti(makeKv(keys, value), null, done);
+        });
+    },
+    prependMulti: function(cb, keys, value, done) {
+        cb.setMulti(makeKv(keys, "a"), null, function() {
+            cb.prependMulti(makeKv(keys, value), null, done);
+        });
+    },
+    getMulti: function(cb, keys, value, done) {
+        cb.getMulti(keys, null, done);
+    },
+    lockMulti: function(cb, keys, value, done) {
+        cb.lockMulti(keys, { locktime: 15 }, function(err, results) {
+            cb.unlockMulti(results, null, done);
+        });
+    },
+    removeMulti: function(cb, keys, value, done) {
+        cb.removeMulti(keys, null, function() {
+            // Put the keys back for the next batch
+            cb.setMulti(makeKv(keys, value), null, done);
+        });
+    },
+    incrMulti: function(cb, keys, value, done) {
+        cb.incrMulti(keys, { initial: 0 }, done);
+    },
+    decrMulti: function(cb, keys, value, done) {
+        cb.decrMulti(keys, { initial: 0 }, done);
+    },
+    observeMulti: function(cb, keys, value, done) {
+        cb.observeMulti(keys, null, done);
+    },
+    // Neither has a public *Multi wrapper, so the native entry points
+    // are called directly, with the options the wrappers would add
+    touchMulti: function(cb, keys, value, done) {
+        cb._cb.touchMulti(keys, { spooled: true, expiry: 0 }, done);
+    },
+    endureMulti: function(cb, keys, value, done) {
+        cb._cb.endureMulti(keys, { spooled: true, persist_to: 1 }, done);
+    }
+};
+
+// Workloads whose keys hold counters rather than the generated values
+var counterWorkloads = { incrMulti: true, decrMulti: true };
+
+function countErrors(results) {
+    var ret = 0;
+    for (var k in results) {
+        if (results[k] && results[k].error) {
+            ret++;
+        }
+    }
+    return ret;
+}
+
+function prepare(cb, name, value, callback) {
+    var keys = makeKeys(0, suiteConfig.keySpace);
+    var kv = makeKv(keys, counterWorkloads[name] ? "0" : value);
+    if (name === "addMulti") {
+        cb.removeMulti(keys, null, function() { callback(); });
+    } else {
+        cb.setMulti(kv, null, function() { callback(); });
+    }
+}
+
+function runOne(cb, name, concurrency, valueSize, callback) {
+    var value = makeValue(valueSize);
+    var workload = workloads[name];
+
+    prepare(cb, name, value, function() {
+        var nextKey = 0;
+        var outstanding = 0;
+        var batches = 0;
+        var errors = 0;
+        var stopping = false;
+        var start;
+
+        function finish() {
+            var elapsed = process.hrtime(start);
+            var seconds = elapsed[0] + elapsed[1] / 1e9;
+            var latency = cb.latencyStats(true);
+
+            callback({
+                operation: name,
+                concurrency: concurrency,
+                valueSize: valueSize,
+                batchSize: suiteConfig.batchSize,
+                seconds: seconds,
+                keys: batches * suiteConfig.batchSize,
+                keysPerSecond: batches * suiteConfig.batchSize / seconds,
+                errors: errors,
+                latency: latency,
+                gc: cb.gcStats(true)
+            });
+        }
+
+        function issue() {
+            var keys = makeKeys(nextKey, suiteConfig.batchSize);
+            nextKey += suiteConfig.batchSize;
+            outstanding++;
+
+            workload(cb, keys, value, function(err, results) {
+                outstanding--;
+                batches++;
+                errors += countErrors(results);
+
+                if (!stopping) {
+                    issue();
+                } else if (!outstanding) {
+                    finish();
+                }
+            });
+        }
+
+        // Start from a clean slate, excluding the setup above
+        cb.latencyStats(true);
+        cb.gcStats(true);
+        start = process.hrtime();
+
+        setTimeout(function() { stopping = true; }, suiteConfig.duration);
+        for (var ii = 0; ii < concurrency; ii++) {
+            issue();
+        }
+    });
+}
+
+function runAll(cb, callback) {
+    var runs = [];
+    Object.keys(workloads).forEach(function(name) {
+        suiteConfig.concurrency.forEach(function(concurrency) {
+            suiteConfig.valueSizes.forEach(function(valueSize) {
+                runs.push([ name, concurrency, valueSize ]);
+            });
+        });
+    });
+
+    var results = [];
+    function next() {
+        var run = runs.shift();
+        if (!run) {
+            return callback(results);
+        }
+
+        runOne(cb, run[0], run[1], run[2], function(result) {
+            results.push(result);
+            process.stderr.write(run.join(" ") + ": " +
+                                 Math.round(result.keysPerSecond) +
+                                 " keys/s\n");
+            next();
+        });
+    }
+    next();
+}
+
+function main(host, done) {
+    var cb = new couchbase.Connection({
+        host: host,
+        bucket: suiteConfig.bucket
+    }, function(err) {
+        if (err) {
+            console.error("Failed to connect to " + host + ": " + err);
+            return done(1);
+        }
+
+        cb.latencyTracking = true;
+        runAll(cb, function(results) {
+            console.log(JSON.stringify({
+                node: process.version,
+                host: suiteConfig.host || "mock",
+                config: {
+                    batchSize: suiteConfig.batchSize,
+                    duration: suiteConfig.duration,
+                    keySpace: suiteConfig.keySpace
+                },
+                results: results
+            }, null, 2));
+
+            cb.shutdown();
+            done(0);
+        });
+    });
+}
+
+if (suiteConfig.host) {
+    main(suiteConfig.host, function(rc) { process.exit(rc); });
+} else {
+    var mock = childProcess.fork(path.join(__dirname, "mockserver.js"));
+    mock.on("message", function(msg) {
+        main("127.0.0.1:" + msg.port, function(rc) {
+            mock.kill();
+            process.exit(rc);
+        });
+    });
+}
@@ -82,10 +82,23 @@
       'src/commandbase.cc',
       'src/commands.cc',
       'src/exception.cc',
+      'src/gcstats.cc',
+      'src/histogram.cc',
+      'src/inflight.cc',
+      'src/nearcache.cc',
       'src/options.cc',
+      'src/routing.cc',
+      'src/snappy.cc',
+      'src/transcoder.cc',
       'src/cas.cc',
+      'src/coalesce.cc',
+      'src/callbackbatch.cc',
+      'src/bufpool.cc',
+      'src/jsoncodec.cc',
+      'src/jsonoffload.cc',
       'src/uv-plugin-all.c',
-      'src/valueformat.cc'
+      'src/valueformat.cc',
+      'src/viewrows.cc'
     ],
     'include_dirs': [
       './',
@@ -139,6 +139,7 @@ function Connection(options, callback) {
   }
 
   this._cb.on('connect', callback);
+  this._cb.on('callbacks', _invokeCallbacks);
 
   try {
     this._cb._connect();
@@ -165,6 +166,31 @@ function _mergeParams(key, kParams, gParams) {
   return ret;
 }
 
+/**
+ * Fan out a batch of operation callbacks, given as a flat array of
+ * callback, error, result triples. Should a callback throw, the rest of
+ * the batch is still delivered, on the next tick, as it would have been
+ * without batching.
+ *
+ * @private
+ * @ignore
+ */
+function _invokeCallbacks(batch) {
+  var ii = 0;
+  try {
+    for (; ii < batch.length; ii += 3) {
+      batch[ii](batch[ii + 1], batch[ii + 2]);
+    }
+  } finally {
+    if (ii < batch.length) {
+      var rest = batch.slice(ii + 3);
+      process.nextTick(function() {
+        _invokeCallbacks(rest);
+      });
+    }
+  }
+}
+
 function _endureError(innerError)
 {
   var out_error = new Error('Durability requirements failed');
@@ -272,8 +298,8 @@ Connection.prototype._invokeStorage = function(tgt, argList) {
     meta = _mergeParams(argList[0], { value: argList[1] }, argList[2] );
     callback = argList[3];
   }
-  tgt.call(this._cb, meta, null,
-      this._interceptEndure(argList[0], meta, {}, false, callback));
+  // persist_to and replicate_to are handled natively for stores
+  tgt.call(this._cb, meta, null, callback);
 };
 
 /**
@@ -401,7 +427,8 @@ Connection.prototype._arithHelper = function(dfl, argList) {
  *  the callback to be invoked when complete.
  *  The second argument of the callback shall contain the following
  *  fields:
- *  @config {string|object|Buffer} value The value for the item
+ *  @config {string|object|Buffer} value The value for the item. JSON
+ *    values are only parsed when this field is first read
  *  @config {CAS} cas The CAS returned from the server
  *  @config {integer} flags The server-side 32 bit flags. See
  *    {@link Connection.set} for more information
@@ -506,6 +533,7 @@ Connection.prototype.unlock = function(key, options, callback) {
  * @param {string|object|Buffer} value the value the key shall contain
  * Note that if the options already contain a 'value' field (e.g. from a callback
  * invoked after a get or getEx operation), this parameter is ignored.
+ * Buffer values are copied unless {@link Connection#borrowBuffers} is set.
  * @param {object=} options Options are:
  *   @param {CAS} options.cas value to use. If the CAS on the server
  *   does not match this value, it is assumed the object has been
@@ -519,7 +547,8 @@ Connection.prototype.unlock = function(key, options, callback) {
  *   specifier.  The only use case for setting this value should be intra-client
  *   compatibility.
  *   @param {integer|string} options.format Format specifier to use for storing this
- *   value.
+ *   value. This may also be the flags of a custom format, see
+ *   {@link registerTranscoder}.
  *   @param {integer} options.persist_to
  *   Ensures this operation is persisted to this many nodes
  *   @param {integer} options.replicate_to
@@ -583,7 +612,10 @@ Connection.prototype.replace = function(key, value, options, callback) {
  * but instead of setting a new value, it appends data
  * to the existing value. Note that this function only makes sense when
  * the stored item is a string; 'appending' to JSON may result in parse
- * errors when the value is later retrieved.
+ * errors when the value is later retrieved. Fragments are never
+ * compressed, and appending to a value which was stored compressed (see
+ * {@link Connection#compressionThreshold}) is unsupported: the result can
+ * no longer be decompressed, and is retrieved as a raw Buffer.
  *
  * @param {string} key
  * @param {string|object} fragment The data to append
@@ -694,7 +726,7 @@ Connection.prototype.observe = function(key, options, callback) {
   this._argHelperMerge2(this._cb.observeMulti, arguments);
 };
 
-Connection.prototype._multiHelper = function(target, argList) {
+Connection.prototype._multiHelper = function(target, argList, nativeEndure) {
   var options = argList[1];
   if (!options) {
     options = { spooled: true };
@@ -704,8 +736,12 @@ Connection.prototype._multiHelper = function(target, argList) {
       options[k] = argList[1][k];
     }
   }
-  target.call(this._cb, argList[0], options,
-      this._interceptEndure(null, argList[0], options, false, argList[2]));
+  if (nativeEndure) {
+    target.call(this._cb, argList[0], options, argList[2]);
+  } else {
+    target.call(this._cb, argList[0], options,
+        this._interceptEndure(null, argList[0], options, false, argList[2]));
+  }
 }
 
 
@@ -762,7 +798,7 @@ Connection.prototype._multiHelper = function(target, argList) {
  * @param {MultiCallback|KeyCallback} callback
  */
 Connection.prototype.setMulti = function(kv, options, callback) {
-  this._multiHelper(this._cb.setMulti, arguments);
+  this._multiHelper(this._cb.setMulti, arguments, true);
 };
 
 /**
@@ -776,7 +812,7 @@ Connection.prototype.setMulti = function(kv, options, callback) {
  * @see Connection#setMulti
  */
 Connection.prototype.addMulti = function(kv, meta, callback) {
-  this._multiHelper(this._cb.addMulti, arguments);
+  this._multiHelper(this._cb.addMulti, arguments, true);
 };
 
 /**
@@ -790,7 +826,7 @@ Connection.prototype.addMulti = function(kv, meta, callback) {
  * @see Connection#setMulti
  */
 Connection.prototype.replaceMulti = function(kv, meta, callback) {
-  this._multiHelper(this._cb.replaceMulti, arguments);
+  this._multiHelper(this._cb.replaceMulti, arguments, true);
 };
 
 /**
@@ -804,7 +840,7 @@ Connection.prototype.replaceMulti = function(kv, meta, callback) {
  * @see Connection#setMulti
  */
 Connection.prototype.appendMulti = function(kv, meta, callback) {
-  this._multiHelper(this._cb.appendMulti, arguments);
+  this._multiHelper(this._cb.appendMulti, arguments, true);
 };
 
 /**
@@ -818,7 +854,7 @@ Connection.prototype.appendMulti = function(kv, meta, callback) {
  * @see Connection#setMulti
  */
 Connection.prototype.prependMulti = function(kv, meta, callback) {
-  this._multiHelper(this._cb.prependMulti, arguments);
+  this._multiHelper(this._cb.prependMulti, arguments, true);
 };
 
 /**
@@ -826,6 +862,15 @@ Connection.prototype.prependMulti = function(kv, meta, callback) {
  *
  * @param {object} kv
  * @param {object=} options
+ *   @param {boolean} options.columnar
+ *   If set, the callback receives a single object of parallel arrays
+ *   instead of one object per key: <code>keys</code>, <code>values</code>,
+ *   <code>flags</code> (a <code>Uint32Array</code>), <code>cas</code> (a
+ *   Buffer holding 8 bytes per key; a slice of it may be passed as the
+ *   <code>cas</code> option of other operations) and, if any key failed,
+ *   <code>errors</code>. Entry <code>i</code> of each refers to the same
+ *   key, in the order the responses arrived. This is considerably cheaper
+ *   for large numbers of keys.
  * @param {MultiCallback|KeyCallback} callback
  *
  * @see Connection#get
@@ -1101,6 +1146,511 @@ Object.defineProperty(Connection.prototype, 'serverNodes', {
   writeable: false
 });
 
+/**
+ * Sets or gets whether get and store operations issued during the same
+ * turn of the event loop are merged and sent to the cluster together.
+ * Operations of other kinds flush any pending batch first, so the order
+ * in which operations were issued is preserved.
+ *
+ * @default false
+ *
+ * @member {boolean} coalesce
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'coalesce', {
+  get: function() {
+    return this._ctl(CONST.CNTL_COALESCE);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_COALESCE, val);
+  }
+});
+
+/**
+ * Sets or gets whether operation callbacks are invoked together, once the
+ * current event loop iteration is done with I/O, rather than each as soon
+ * as its response arrives. JavaScript is then entered once for all the
+ * responses received at once, instead of once per key, which matters
+ * when many small operations are in flight. Callbacks are still invoked
+ * in the order their responses arrived. Only operations issued while
+ * this is set are affected.
+ *
+ * @default false
+ *
+ * @member {boolean} callbackBatching
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'callbackBatching', {
+  get: function() {
+    return this._ctl(CONST.CNTL_CALLBACK_BATCHING);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_CALLBACK_BATCHING, val);
+  }
+});
+
+/**
+ * Sets or gets whether JSON values retrieved by gets are only parsed
+ * when the <code>value</code> field of the result is first read. This
+ * saves the parse for callers which only look at the <code>cas</code>
+ * or the <code>flags</code>, at the cost of a copy of the encoded value
+ * for those which do read it. Only operations issued while this is set
+ * are affected.
+ *
+ * @default false
+ *
+ * @member {boolean} lazyValues
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'lazyValues', {
+  get: function() {
+    return this._ctl(CONST.CNTL_LAZY_VALUES);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_LAZY_VALUES, val);
+  }
+});
+
+/**
+ * Sets or gets whether Buffer values are stored straight from the
+ * Buffer's own memory instead of being copied first. This saves a copy
+ * per store of large values, but a Buffer must then not be modified or
+ * reused (e.g. returned to a pool) until the callback of the operation
+ * storing it has been invoked, or corrupted data may be stored. Only
+ * operations issued while this is set are affected.
+ *
+ * @default false
+ *
+ * @member {boolean} borrowBuffers
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'borrowBuffers', {
+  get: function() {
+    return this._ctl(CONST.CNTL_BORROW_BUFFERS);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_BORROW_BUFFERS, val);
+  }
+});
+
+/**
+ * Sets or gets whether keys failing with an expected status, i.e. a
+ * missing key (<code>keyNotFound</code>) or an existing one
+ * (<code>keyAlreadyExists</code>), all report the same frozen Error for
+ * that status instead of a new Error each. Creating an Error, with its
+ * message and stack trace, is comparatively expensive; this matters for
+ * workloads where misses are frequent. Shared errors cannot be modified,
+ * and their stack trace is meaningless. Other failures are unaffected.
+ * Only operations issued while this is set are affected.
+ *
+ * @default false
+ *
+ * @member {boolean} sharedErrors
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'sharedErrors', {
+  get: function() {
+    return this._ctl(CONST.CNTL_SHARED_ERRORS);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_SHARED_ERRORS, val);
+  }
+});
+
+/**
+ * Sets or gets the size, in bytes, of the near cache: an in-process cache
+ * of the documents last retrieved by this connection. Gets of cached keys
+ * are answered without a round trip to the cluster, until the entry
+ * expires (see {@link Connection#nearCacheTtl}) or is changed by a store,
+ * remove or arithmetic operation of this connection. Such a change takes
+ * effect as soon as it is issued, so a get issued after it always sees its
+ * result. Changes made by other clients are not seen until then, so only
+ * enable this for data which tolerates being slightly stale. Gets with a
+ * <code>locktime</code>, an <code>expiry</code> or a <code>hashkey</code>
+ * always go to the cluster. Setting this empties the cache; 0 disables
+ * it.
+ *
+ * @default 0
+ *
+ * @member {number} nearCacheSize
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'nearCacheSize', {
+  get: function() {
+    return this._ctl(CONST.CNTL_NEAR_CACHE_SIZE);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_NEAR_CACHE_SIZE, val);
+  }
+});
+
+/**
+ * Sets or gets whether a get for a key which this connection is already
+ * fetching waits for that response instead of sending its own, so that
+ * many concurrent gets of a hot key reach the cluster once. Duplicate keys
+ * within one getMulti are fetched once as well. Every caller receives its
+ * own result, decoded with its own options. Gets with a
+ * <code>locktime</code>, an <code>expiry</code> or a
+ * <code>hashkey</code> are always sent, as are gets of a key which this
+ * connection has stored, removed or changed since the fetch in flight was
+ * issued. Only gets and mutations issued while this is set take part.
+ *
+ * @default false
+ *
+ * @member {boolean} getDeduplication
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'getDeduplication', {
+  get: function() {
+    return this._ctl(CONST.CNTL_GET_DEDUP);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_GET_DEDUP, val);
+  }
+});
+
+/**
+ * Get the number of keys whose get waited for the response to another
+ * one, since the connection was created. See
+ * {@link Connection#getDeduplication}.
+ *
+ * @member {integer} getsDeduplicated
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'getsDeduplicated', {
+  get: function() {
+    return this._ctl(CONST.CNTL_GET_DEDUP_JOINED);
+  },
+  writeable: false
+});
+
+/**
+ * Sets or gets how long, in milliseconds, a document stays in the near
+ * cache after being retrieved. Applies to entries cached from then on.
+ *
+ * @default 1000
+ *
+ * @member {number} nearCacheTtl
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'nearCacheTtl', {
+  get: function() {
+    return this._ctl(CONST.CNTL_NEAR_CACHE_TTL);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_NEAR_CACHE_TTL, val);
+  }
+});
+
+/**
+ * Sets or gets the number of keys after which a coalesced batch is sent
+ * immediately.
+ *
+ * @default 1024
+ *
+ * @member {number} coalesceMaxBatch
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'coalesceMaxBatch', {
+  get: function() {
+    return this._ctl(CONST.CNTL_COALESCE_MAXBATCH);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_COALESCE_MAXBATCH, val);
+  }
+});
+
+/**
+ * Sets or gets the time in msecs an operation may wait for others to
+ * be coalesced with. If 0, batches are sent at the end of the current
+ * event loop iteration.
+ *
+ * @default 0
+ *
+ * @member {number} coalesceMaxDelay
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'coalesceMaxDelay', {
+  get: function() {
+    return this._ctl(CONST.CNTL_COALESCE_MAXDELAY);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_COALESCE_MAXDELAY, val);
+  }
+});
+
+/**
+ * Sets or gets the maximum number of operations which may be queued
+ * while the connection is being established. Once this is reached,
+ * further operations either fail with <code>errors.queueFull</code> (if
+ * {@link Connection#pendingFailFast} is set) or are queued regardless.
+ * In both cases a <code>drain</code> event is emitted once the queue has
+ * been flushed. A value of 0 means no limit.
+ *
+ * @default 0
+ *
+ * @member {number} pendingLimit
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'pendingLimit', {
+  get: function() {
+    return this._ctl(CONST.CNTL_PENDING_LIMIT);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_PENDING_LIMIT, val);
+  }
+});
+
+/**
+ * Sets or gets whether operations beyond
+ * {@link Connection#pendingLimit} fail immediately.
+ *
+ * @default false
+ *
+ * @member {boolean} pendingFailFast
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'pendingFailFast', {
+  get: function() {
+    return this._ctl(CONST.CNTL_PENDING_FAILFAST);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_PENDING_FAILFAST, val);
+  }
+});
+
+/**
+ * Get the state of the queue of operations waiting for the connection.
+ *
+ * @return an object with the following fields:
+ *  <code>depth</code> for the number of queued operations and
+ *  <code>bytes</code> for the memory held by their keys and values.
+ *
+ * @member {object} pendingStats
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'pendingStats', {
+  get: function() {
+    return this._ctl(CONST.CNTL_PENDING_STATS);
+  },
+  writeable: false
+});
+
+/**
+ * Get the number of operations issued on this connection whose callback
+ * has not been invoked yet, including those waiting for the connection.
+ * A multi operation counts once, however many keys it has.
+ *
+ * @member {integer} outstanding
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'outstanding', {
+  get: function() {
+    return this._ctl(CONST.CNTL_OUTSTANDING);
+  },
+  writeable: false
+});
+
+/**
+ * Sets or gets whether the time taken by each key of an operation is
+ * recorded. See {@link Connection#latencyStats}.
+ *
+ * @default false
+ *
+ * @member {boolean} latencyTracking
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'latencyTracking', {
+  get: function() {
+    return this._ctl(CONST.CNTL_LATENCY_TRACKING);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_LATENCY_TRACKING, val);
+  }
+});
+
+/**
+ * Get the latencies recorded while {@link Connection#latencyTracking} was
+ * enabled, from the time an operation was issued until the response for
+ * each of its keys arrived.
+ *
+ * @param {boolean=} reset if true, the recorded latencies are cleared
+ *  after being read
+ * @return an object keyed by operation type (<code>get</code>,
+ *  <code>set</code>, <code>remove</code> ...) where each value contains
+ *  <code>count</code>, <code>min</code>, <code>max</code>,
+ *  <code>mean</code>, <code>p50</code>, <code>p90</code>,
+ *  <code>p99</code> and <code>p999</code>. Durations are in microseconds.
+ */
+Connection.prototype.latencyStats = function(reset) {
+  var ret = this._ctl(CONST.CNTL_LATENCY);
+  if (reset) {
+    this._ctl(CONST.CNTL_LATENCY, true);
+  }
+  return ret;
+};
+
+/**
+ * Get the garbage collector counters of this process. The counters are
+ * shared by all connections and only start counting once they have been
+ * reset at least once.
+ *
+ * @param {boolean=} reset if true, the counters are cleared after being
+ *  read
+ * @return an object with <code>count</code> (the number of collections),
+ *  <code>pauseMs</code> (total time spent collecting),
+ *  <code>allocated</code> (estimated bytes allocated on the heap) and
+ *  <code>heapUsed</code>
+ */
+Connection.prototype.gcStats = function(reset) {
+  var ret = this._ctl(CONST.CNTL_GC_STATS);
+  if (reset) {
+    this._ctl(CONST.CNTL_GC_STATS, true);
+  }
+  return ret;
+};
+
+/**
+ * Get the counters of the near cache. See
+ * {@link Connection#nearCacheSize}.
+ *
+ * @param {boolean=} reset if true, the counters are cleared after being
+ *  read
+ * @return an object with the number of gets answered from the cache
+ *  (<code>hits</code>) or not (<code>misses</code>, of which
+ *  <code>expired</code> found a stale entry), the number of entries
+ *  dropped to make room (<code>evictions</code>) or because this
+ *  connection changed them (<code>invalidations</code>), and the current
+ *  number of <code>entries</code> and their size in <code>bytes</code>
+ */
+Connection.prototype.nearCacheStats = function(reset) {
+  var ret = this._ctl(CONST.CNTL_NEAR_CACHE_STATS);
+  if (reset) {
+    this._ctl(CONST.CNTL_NEAR_CACHE_STATS, true);
+  }
+  return ret;
+};
+
+/**
+ * Get the counters of the buffer pool used to encode keys and values.
+ *
+ * @return an object with the following fields:
+ *  <code>hits</code> and <code>misses</code> for allocations which were
+ *  (or were not) satisfied by previously released buffers,
+ *  <code>unpooled</code> for allocations too large to be pooled,
+ *  <code>resident</code> for the bytes currently allocated by the pool and
+ *  <code>idle</code> for the bytes waiting to be reused.
+ *
+ * @member {object} bufferPoolStats
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'bufferPoolStats', {
+  get: function() {
+    return this._ctl(CONST.CNTL_BUFPOOL_STATS);
+  },
+  writeable: false
+});
+
+/**
+ * Sets or gets which JSON conversions are done by the native codec rather
+ * than <code>JSON.stringify</code> and <code>JSON.parse</code>. This is a
+ * bitmask of <code>1</code> (encoding values for storage) and
+ * <code>2</code> (decoding retrieved values). Values which the native codec
+ * cannot handle are still passed to the <code>JSON</code> functions.
+ *
+ * Note that this setting is shared by all connections in the process.
+ *
+ * @default 1
+ *
+ * @member {number} nativeJson
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'nativeJson', {
+  get: function() {
+    return this._ctl(CONST.CNTL_NATIVE_JSON);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_NATIVE_JSON, val);
+  }
+});
+
+/**
+ * Sets or gets the size, in bytes, from which retrieved JSON values are
+ * parsed on a worker thread rather than on the main thread, so that a
+ * large document does not hold up every other response. Values of keys
+ * offloaded this way may be reported after those of keys retrieved
+ * later. 0 disables offloading.
+ *
+ * Note that this setting is shared by all connections in the process.
+ *
+ * @default 0
+ *
+ * @member {number} jsonOffloadThreshold
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'jsonOffloadThreshold', {
+  get: function() {
+    return this._ctl(CONST.CNTL_JSON_OFFLOAD);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_JSON_OFFLOAD, val);
+  }
+});
+
+/**
+ * Sets or gets the size, in bytes, from which stored values are
+ * compressed with Snappy, unless they would shrink by less than an
+ * eighth. Compressed values are marked by <code>0x20</code> in their
+ * flags, on top of their format, and are decompressed transparently when
+ * retrieved while this is non-zero or {@link Connection#decompression}
+ * is set. Values stored with explicit <code>flags</code>, and fragments
+ * passed to append or prepend, are never compressed; appending to a value
+ * stored compressed is unsupported. 0 disables compression.
+ *
+ * This marking is specific to this client. Other clients will see the
+ * Snappy bytes as-is, and the PHP 1.x client uses the same bit for zlib
+ * compressed values (<code>COUCHBASE_COMPRESSION_ZLIB</code>), which is
+ * why the bit is ignored unless compression is in use here.
+ *
+ * Note that this setting is shared by all connections in the process.
+ *
+ * @default 0
+ *
+ * @member {number} compressionThreshold
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'compressionThreshold', {
+  get: function() {
+    return this._ctl(CONST.CNTL_COMPRESSION);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_COMPRESSION, val);
+  }
+});
+
+/**
+ * Sets or gets whether retrieved values flagged as compressed are
+ * decompressed while {@link Connection#compressionThreshold} is 0, for
+ * processes which read values written with compression but do not
+ * compress themselves. Only set this if the bucket holds no values
+ * written by clients which use <code>0x20</code> for something else.
+ *
+ * Note that this setting is shared by all connections in the process.
+ *
+ * @default false
+ *
+ * @member {boolean} decompression
+ * @memberOf Connection#
+ */
+Object.defineProperty(Connection.prototype, 'decompression', {
+  get: function() {
+    return this._ctl(CONST.CNTL_DECOMPRESSION);
+  },
+  set: function(val) {
+    this._ctl(CONST.CNTL_DECOMPRESSION, val);
+  }
+});
+
 /**
  * @static
  * Return the string representation of an error code.
@@ -1126,6 +1676,45 @@ Connection.prototype.vbMappingInfo = function(key) {
   return this._ctl(CONST.LCB_CNTL_VBMAP, key);
 };
 
+/**
+ * Map several keys to their vbuckets and servers with a single call into
+ * the library.
+ *
+ * @param {string[]} keys the keys to map
+ * @return an object with <code>vbuckets</code> (a Uint32Array) and
+ *  <code>servers</code> (an Int32Array, -1 where a vbucket has no active
+ *  server) holding the mapping of each key in order, <code>hosts</code>
+ *  listing the host name of each server index, and
+ *  <code>generation</code>, which changes whenever a new cluster
+ *  configuration is received and so invalidates previous mappings.
+ */
+Connection.prototype.vbMappingMulti = function(keys) {
+  return this._cb._control(CONST.CNTL_VBMAP_MULTI, CONST.LCB_CNTL_GET, keys);
+};
+
+/**
+ * Group keys by the server currently responsible for them, e.g. to split
+ * a large multi operation into one batch per node.
+ *
+ * @param {string[]} keys the keys to group
+ * @return an object of <code>{host: [keys]}</code>. Keys whose vbucket has
+ *  no active server are grouped under an empty host name.
+ */
+Connection.prototype.groupKeysByServer = function(keys) {
+  var mapping = this.vbMappingMulti(keys);
+  var ret = {};
+
+  for (var i = 0; i < keys.length; i++) {
+    var ix = mapping.servers[i];
+    var host = ix < 0 ? '' : mapping.hosts[ix];
+    if (!ret[host]) {
+      ret[host] = [];
+    }
+    ret[host].push(keys[i]);
+  }
+  return ret;
+};
+
 
 /**
  * Returns a ViewQuery object representing the requested view.
@@ -1195,6 +1784,10 @@ Connection.prototype.removeDesignDoc = function(name, callback) {
 
 module.exports.Connection = Connection;
 
+var pool = require('./pool.js');
+pool._init(Connection);
+module.exports.ConnectionPool = pool.ConnectionPool;
+
 /**
  * Enumeration of all error codes.  See libcouchbase documentation
  * for more details on what these errors represent.
@@ -1255,7 +1848,8 @@ module.exports.errors = {
   schedulingError: CONST['ErrorCode::SCHEDULING'],
   checkResults: CONST['ErrorCode::CHECK_RESULTS'],
   genericError: CONST['ErrorCode::GENERIC'],
-  durabilityFailed: CONST['ErrorCode::DURABILITY_FAILED']
+  durabilityFailed: CONST['ErrorCode::DURABILITY_FAILED'],
+  queueFull: CONST['ErrorCode::QUEUE_FULL']
 };
 
 /**
@@ -1271,3 +1865,25 @@ module.exports.format = {
   utf8: CONST['ValueFormat::UTF8'],
   auto: CONST['ValueFormat::AUTO']
 };
+
+/**
+ * Register a custom value format, identified by the flags stored with its
+ * values. A value stored with these flags as its <code>format</code> is
+ * encoded by <code>transcoder.encode(value)</code>, which must return a
+ * Buffer or a string (stored as UTF-8). Any value retrieved with these
+ * flags is passed as a Buffer to <code>transcoder.decode(buffer)</code>,
+ * and returned as is should decode throw.
+ *
+ * The flags must fit in 23 bits, must not be those of a built-in format
+ * and must not include the compression bit (<code>0x20</code>); custom
+ * values are compressed like any other.
+ *
+ * Note that transcoders are shared by all connections in the process.
+ *
+ * @param {integer} flags the flags of the format
+ * @param {object} transcoder an object with <code>encode</code> and
+ *  <code>decode</code> functions, or null to unregister the format
+ */
+module.exports.registerTranscoder = function(flags, transcoder) {
+  couchnode.registerTranscoder(flags, transcoder || null);
+};
@@ -28,26 +28,7 @@ function makeRestHandler(innerCallback) {
       console.log('View Debugging Information Returned: ', body.debug_info);
     }
 
-    // This should probably be updated to act differently
-    var errObj = null;
-    if (body && body.error) {
-      errObj = new Error("REST error " + body.error);
-      errObj.code = 9999;
-      if (body.reason) {
-        errObj.reason = body.reason;
-      }
-    }
-    if (body && body.errors) {
-      errObj = [];
-      for (var i = 0; i < body.errors.length; ++i) {
-        var tmpErrObj = new Error("REST error " + body.errors[i]);
-        tmpErrObj.code = 9999;
-        if (body.errors[i].reason) {
-          tmpErrObj.reason = body.errors[i].reason;
-        }
-        errObj.push(tmpErrObj);
-      }
-    }
+    var errObj = viewQuery.makeRestError(body);
 
     if (body.rows) {
       innerCallback(errObj, body.rows);
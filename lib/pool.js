@@ -0,0 +1,342 @@
+'use strict';
+
+var Connection;
+
+var DEFAULT_POOL_SIZE = 4;
+var DISPATCH_ROUND_ROBIN = 'round-robin';
+var DISPATCH_LEAST_OUTSTANDING = 'least-outstanding';
+
+// Methods applied to every connection of the pool rather than to one
+var BROADCAST_METHODS = ['on', 'shutdown'];
+
+// Latency fields which cannot be combined exactly across connections
+var PERCENTILES = ['p50', 'p90', 'p99', 'p999'];
+
+/**
+ * @class ConnectionPool
+ *
+ * @classdesc
+ * A set of connections to the same bucket, with the same settings, which
+ * spreads operations between them. Each connection has its own sockets,
+ * so a large response on one of them (e.g. to a big getMulti) does not
+ * hold up the operations dispatched to the others.
+ *
+ * A ConnectionPool has the methods and settings of {@link Connection}.
+ * Each operation is dispatched to a single connection. Settings are
+ * applied to every connection, and statistics are summed over them.
+ *
+ * @constructor
+ *
+ * @param {object} options The options of {@link Connection}, and:
+ *   @param {integer=} options.poolSize
+ *   The number of connections. Default is 4
+ *   @param {string=} options.dispatch
+ *   How the connection for each operation is chosen:
+ *   <code>'least-outstanding'</code> (the default) picks the connection
+ *   with the fewest operations in flight, and
+ *   <code>'round-robin'</code> uses each connection in turn.
+ * @param {Function} callback
+ * Invoked once every connection is connected, or with the first error.
+ */
+function ConnectionPool(options, callback) {
+  if (!callback) {
+    callback = function(err) {
+      if (err) {
+        throw err;
+      }
+    };
+  }
+
+  if (typeof options !== 'object') {
+    return callback(new Error('Options must be an object'));
+  }
+
+  var connOptions = {};
+  for (var kName in options) {
+    if (options.hasOwnProperty(kName) &&
+        kName !== 'poolSize' && kName !== 'dispatch') {
+      connOptions[kName] = options[kName];
+    }
+  }
+
+  var size = options.poolSize;
+  if (size === undefined) {
+    size = DEFAULT_POOL_SIZE;
+  }
+  if (!(size >= 1)) {
+    return callback(new Error('poolSize must be at least 1'));
+  }
+
+  var dispatch = options.dispatch || DISPATCH_LEAST_OUTSTANDING;
+  if (dispatch !== DISPATCH_LEAST_OUTSTANDING &&
+      dispatch !== DISPATCH_ROUND_ROBIN) {
+    return callback(new Error('Unknown dispatch policy: ' + dispatch));
+  }
+
+  this.connections = [];
+  this.dispatch = dispatch;
+  this._next = 0;
+  this._dispatched = [];
+
+  var remaining = size;
+  var failed = false;
+  function onConnect(err) {
+    if (failed) {
+      return;
+    }
+    if (err) {
+      failed = true;
+      return callback(err);
+    }
+    if (--remaining === 0) {
+      callback(null);
+    }
+  }
+
+  for (var ii = 0; ii < size; ii++) {
+    this.connections.push(new Connection(connOptions, onConnect));
+    this._dispatched.push(0);
+  }
+}
+
+/**
+ * Choose the connection for the next operation.
+ *
+ * @private
+ * @ignore
+ */
+ConnectionPool.prototype._pick = function() {
+  var conns = this.connections;
+  var start = this._next;
+  var best = start;
+
+  this._next = (start + 1) % conns.length;
+
+  if (this.dispatch === DISPATCH_LEAST_OUTSTANDING) {
+    // Scan from the round-robin position so that ties are spread evenly
+    var bestCount = conns[start].outstanding;
+    for (var ii = 1; ii < conns.length && bestCount > 0; ii++) {
+      var ix = (start + ii) % conns.length;
+      var count = conns[ix].outstanding;
+      if (count < bestCount) {
+        best = ix;
+        bestCount = count;
+      }
+    }
+  }
+
+  this._dispatched[best]++;
+  return conns[best];
+};
+
+/**
+ * Get the number of operations in flight on all the connections.
+ *
+ * @member {integer} outstanding
+ * @memberOf ConnectionPool#
+ */
+Object.defineProperty(ConnectionPool.prototype, 'outstanding', {
+  get: function() {
+    return sumStats(this.connections, 'outstanding');
+  },
+  writeable: false
+});
+
+/**
+ * Get the state of the queues of operations waiting for the connections,
+ * summed over the pool. See {@link Connection#pendingStats}.
+ *
+ * @member {object} pendingStats
+ * @memberOf ConnectionPool#
+ */
+Object.defineProperty(ConnectionPool.prototype, 'pendingStats', {
+  get: function() {
+    return sumStats(this.connections, 'pendingStats');
+  },
+  writeable: false
+});
+
+/**
+ * Get the buffer pool counters, summed over the pool. See
+ * {@link Connection#bufferPoolStats}.
+ *
+ * @member {object} bufferPoolStats
+ * @memberOf ConnectionPool#
+ */
+Object.defineProperty(ConnectionPool.prototype, 'bufferPoolStats', {
+  get: function() {
+    return sumStats(this.connections, 'bufferPoolStats');
+  },
+  writeable: false
+});
+
+/**
+ * Get the number of gets which waited for another one's response, summed
+ * over the pool. See {@link Connection#getsDeduplicated}.
+ *
+ * @member {integer} getsDeduplicated
+ * @memberOf ConnectionPool#
+ */
+Object.defineProperty(ConnectionPool.prototype, 'getsDeduplicated', {
+  get: function() {
+    return sumStats(this.connections, 'getsDeduplicated');
+  },
+  writeable: false
+});
+
+/**
+ * Get the latencies recorded by all the connections. Counts, minimums,
+ * maximums and means are exact; as percentiles cannot be combined, each
+ * percentile is the highest of those of the connections.
+ *
+ * @param {boolean=} reset if true, the recorded latencies are cleared
+ *  after being read
+ * @return see {@link Connection#latencyStats}
+ */
+ConnectionPool.prototype.latencyStats = function(reset) {
+  var ret = {};
+
+  this.connections.forEach(function(conn) {
+    var stats = conn.latencyStats(reset);
+    for (var op in stats) {
+      var cur = stats[op];
+      var agg = ret[op];
+
+      if (!agg) {
+        ret[op] = cur;
+        continue;
+      }
+
+      var count = agg.count + cur.count;
+      agg.mean = (agg.mean * agg.count + cur.mean * cur.count) / count;
+      agg.min = Math.min(agg.min, cur.min);
+      agg.max = Math.max(agg.max, cur.max);
+      PERCENTILES.forEach(function(p) {
+        agg[p] = Math.max(agg[p], cur[p]);
+      });
+      agg.count = count;
+    }
+  });
+  return ret;
+};
+
+/**
+ * Get the near cache counters, summed over the pool. Each connection has
+ * its own cache. See {@link Connection#nearCacheStats}.
+ *
+ * @param {boolean=} reset if true, the counters are cleared after being
+ *  read
+ */
+ConnectionPool.prototype.nearCacheStats = function(reset) {
+  var ret = {};
+  this.connections.forEach(function(conn) {
+    var cur = conn.nearCacheStats(reset);
+    for (var k in cur) {
+      ret[k] = (ret[k] || 0) + cur[k];
+    }
+  });
+  return ret;
+};
+
+/**
+ * Get the state of each connection of the pool.
+ *
+ * @return an object with <code>dispatch</code> (the dispatch policy) and
+ *  <code>connections</code>, an array with the <code>outstanding</code>
+ *  operations of each connection and the number of operations
+ *  <code>dispatched</code> to it so far.
+ */
+ConnectionPool.prototype.poolStats = function() {
+  var dispatched = this._dispatched;
+  return {
+    dispatch: this.dispatch,
+    connections: this.connections.map(function(conn, ix) {
+      return {
+        outstanding: conn.outstanding,
+        dispatched: dispatched[ix]
+      };
+    })
+  };
+};
+
+function sumStats(conns, name) {
+  var ret;
+  conns.forEach(function(conn) {
+    var cur = conn[name];
+    if (typeof cur === 'number') {
+      ret = (ret || 0) + cur;
+      return;
+    }
+
+    ret = ret || {};
+    for (var k in cur) {
+      ret[k] = (ret[k] || 0) + cur[k];
+    }
+  });
+  return ret;
+}
+
+function dispatchMethod(name) {
+  return function() {
+    var conn = this._pick();
+    return conn[name].apply(conn, arguments);
+  };
+}
+
+function broadcastMethod(name) {
+  return function() {
+    var args = arguments;
+    this.connections.forEach(function(conn) {
+      conn[name].apply(conn, args);
+    });
+  };
+}
+
+function broadcastProperty(name, desc) {
+  var ret = {
+    get: function() {
+      return this.connections[0][name];
+    }
+  };
+
+  if (desc.set) {
+    ret.set = function(val) {
+      this.connections.forEach(function(conn) {
+        conn[name] = val;
+      });
+    };
+  }
+  return ret;
+}
+
+/**
+ * Mirror the public interface of Connection, which is not yet defined
+ * when this module is loaded.
+ *
+ * @private
+ * @ignore
+ */
+module.exports._init = function(c) {
+  Connection = c;
+
+  Object.getOwnPropertyNames(Connection.prototype).forEach(function(name) {
+    if (name[0] === '_' || name === 'constructor' ||
+        ConnectionPool.prototype.hasOwnProperty(name)) {
+      return;
+    }
+
+    var desc = Object.getOwnPropertyDescriptor(Connection.prototype, name);
+    if (typeof desc.value === 'function') {
+      if (BROADCAST_METHODS.indexOf(name) !== -1) {
+        ConnectionPool.prototype[name] = broadcastMethod(name);
+      } else {
+        ConnectionPool.prototype[name] = dispatchMethod(name);
+      }
+    } else if (desc.get) {
+      Object.defineProperty(ConnectionPool.prototype, name,
+                            broadcastProperty(name, desc));
+    }
+  });
+};
+
+module.exports.ConnectionPool = ConnectionPool;
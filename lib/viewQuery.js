@@ -1,4 +1,6 @@
 var qs = require("querystring");
+var util = require("util");
+var EventEmitter = require("events").EventEmitter;
 var httpUtil = require('./http');
 
 var DEFAULT_LIMIT = 10;
@@ -85,6 +87,58 @@ ViewQuery.prototype.query = function(q, callback) {
   return this
 }
 
+/**
+ * Query for result set, delivering the rows as they arrive instead of
+ * once the whole response has been received. Large results are thus
+ * never held in memory or parsed all at once.
+ *
+ * With <code>include_docs</code>, the documents are fetched from the
+ * cluster by the client itself while the rest of the view is still being
+ * received, and set as the <code>doc</code> field of each row. As with
+ * the view engine's own include_docs, a document is an object with its
+ * <code>meta</code> (<code>id</code>, <code>cas</code> and
+ * <code>flags</code>) and its body as <code>json</code> if it parses as
+ * JSON, whatever its format, or as <code>base64</code> otherwise.
+ *
+ * @param {object=} q key,value pairs supplying additional set of query
+ *    parameters to be used for this query.
+ * @returns {ViewStream}
+ */
+ViewQuery.prototype.stream = function(q) {
+  var q = extend( extend({}, this.q), normalizeQuery(q || {}) );
+  return this._stream(q);
+}
+
+/**
+ * Streamed query, on an already normalized set of parameters.
+ *
+ * @private
+ * @ignore
+ */
+ViewQuery.prototype._stream = function(q) {
+  var stream = new ViewStream();
+  var includeDocs = q.include_docs === true || q.include_docs === "true";
+
+  if (includeDocs) {
+    // The view engine is not asked for the documents; they are fetched
+    // over the memcached protocol instead
+    q = extend({}, q);
+    delete q.include_docs;
+  }
+
+  this._cb.httpRequest(null, {
+    path: "_design/" + this.ddoc + "/_view/" + this.name + "?"
+          + qs.stringify(q),
+    lcb_http_type: CONST.LCB_HTTP_TYPE_VIEW,
+    method: CONST.LCB_HTTP_METHOD_GET,
+    stream: stream,
+    include_docs: includeDocs
+  }, function(err, response) {
+    stream._onEnd(err, response);
+  });
+  return stream;
+}
+
 /**
  * Clone this query instance, with a new set of initial parameters overriding
  * current set.
@@ -154,6 +208,18 @@ ViewQuery.prototype.firstPage = function(q, callback) {
  * @ignore
  */
 ViewQuery.prototype._request = function(q, callback) {
+  if (q.include_docs === true || q.include_docs === "true") {
+    var rows = [];
+    this._stream(q).on('rows', function(batch) {
+      rows.push.apply(rows, batch);
+    }).on('error', function(err) {
+      callback(err, null);
+    }).on('end', function(meta, errors) {
+      callback(errors, rows);
+    });
+    return;
+  }
+
   this._cb.httpRequest(null, {
     path: "_design/" + this.ddoc + "/_view/" + this.name + "?" 
           + qs.stringify(q),
@@ -273,6 +339,119 @@ Paginator.prototype.prev = function(callback) {
 
 
 
+/**
+ * @class ViewStream
+ *
+ * Emits <code>'rows'</code> with an array of rows each time a batch of
+ * rows has been received, then either <code>'end'</code> with the rest
+ * of the response (e.g. <code>total_rows</code>) or <code>'error'</code>.
+ * When only some nodes failed, as with <code>on_error=continue</code>,
+ * <code>'end'</code> is given an array of their errors as well, and null
+ * otherwise.
+ */
+
+/**
+ * @constructor
+ * @private
+ * @ignore
+ */
+function ViewStream() {
+  EventEmitter.call(this);
+  this.paused = false;
+}
+util.inherits(ViewStream, EventEmitter);
+
+/**
+ * Stop delivering rows until {@link ViewStream#resume} is called. Rows
+ * received in the meantime are queued natively, as raw text.
+ */
+ViewStream.prototype.pause = function() {
+  this.paused = true;
+  this._flowControl(true);
+}
+
+/**
+ * Resume delivering rows, starting with any queued while paused.
+ */
+ViewStream.prototype.resume = function() {
+  this.paused = false;
+  this._flowControl(false);
+}
+
+// Called by the native layer
+ViewStream.prototype._onRows = function(rows) {
+  this.emit('rows', rows);
+}
+
+ViewStream.prototype._onEnd = function(err, response) {
+  var meta = null;
+
+  if (response) {
+    if (!err && (response.status < 200 || response.status > 299)) {
+      err = new Error("HTTP error " + response.status);
+    }
+
+    try {
+      meta = JSON.parse(response.data);
+    } catch (parseError) {
+      err = err || parseError;
+    }
+  }
+
+  if (meta && meta.debug_info) {
+    // if debug information is returned, log it for the user
+    console.log('View Debugging Information Returned: ', meta.debug_info);
+  }
+
+  // Errors from some of the nodes come with the rows of the others
+  var restErr = makeRestError(meta);
+  if (restErr && !Array.isArray(restErr)) {
+    err = restErr;
+    restErr = null;
+  }
+
+  if (err) {
+    this.emit('error', err);
+  } else {
+    if (meta) {
+      delete meta.rows;
+    }
+    this.emit('end', meta, restErr);
+  }
+}
+
+/**
+ * Builds the error to report for the body of a view response: an Error
+ * for <code>error</code>, or an array of them for the per-node
+ * <code>errors</code> of a partial result, or null.
+ *
+ * @private
+ * @ignore
+ */
+function makeRestError(body) {
+  // This should probably be updated to act differently
+  var errObj = null;
+  if (body && body.error) {
+    errObj = new Error("REST error " + body.error);
+    errObj.code = 9999;
+    if (body.reason) {
+      errObj.reason = body.reason;
+    }
+  }
+  if (body && body.errors) {
+    errObj = [];
+    for (var i = 0; i < body.errors.length; ++i) {
+      var tmpErrObj = new Error("REST error " + body.errors[i]);
+      tmpErrObj.code = 9999;
+      if (body.errors[i].reason) {
+        tmpErrObj.reason = body.errors[i].reason;
+      }
+      errObj.push(tmpErrObj);
+    }
+  }
+  return errObj;
+}
+
 function extend(dest, src) {
   for (var k in src) {
     if (src.hasOwnProperty(k)) {
@@ -302,3 +481,5 @@ function normalizeQuery(query) {
 
 
 module.exports.ViewQuery = ViewQuery;
+module.exports.ViewStream = ViewStream;
+module.exports.makeRestError = makeRestError;
@@ -17,7 +17,9 @@
 
 #ifndef COUCHNODE_BUFLIST_H
 #define COUCHNODE_BUFLIST_H
+#include <cassert>
 #include <cstdlib>
+#include "bufpool.h"
 namespace Couchnode
 {
 
@@ -30,8 +32,17 @@ public:
      *
      * For now, it serves as a convenient place to allocate all our string
      * pointers without each command worrying about freeing them.
+     *
+     * If a BufferPool is set, chunks are taken from (and returned to) the
+     * pool rather than the system allocator.
      */
-    BufferList() : curBuf(NULL), bytesUsed(0), bytesAllocated(defaultSize) { }
+    BufferList() : curBuf(NULL), bytesUsed(0), bytesAllocated(defaultSize),
+            totalBytes(0), pool(NULL) { }
+
+    void setPool(BufferPool *p) {
+        assert(bufList.empty());
+        pool = p;
+    }
 
     char *getBuffer(size_t len) {
         char *ret;
@@ -40,17 +51,13 @@ public:
         }
 
         if (len >= bytesAllocated) {
-            ret = new char[len];
-            bufList.push_back(ret);
-            return ret;
+            return allocChunk(len);
         }
 
         if (!curBuf) {
-            if (!(curBuf = new char[bytesAllocated])) {
+            if (!(curBuf = allocChunk(bytesAllocated))) {
                 return NULL;
             }
-
-            bufList.push_back(curBuf);
         }
 
         if (bytesAvailable() > len) {
@@ -67,37 +74,83 @@ public:
         return ret;
     }
 
+    /**
+     * Give back the unused tail of the most recent allocation
+     * @param p the pointer returned by getBuffer()
+     * @param used how much of it was used
+     * @param len the size originally requested
+     */
+    void trimLast(char *p, size_t used, size_t len) {
+        if (curBuf && p + len == curBuf) {
+            curBuf = p + used;
+            bytesUsed -= len - used;
+        }
+    }
+
     bool empty() { return bufList.empty(); }
 
+    // Size of all chunks held by this list
+    size_t getTotalBytes() const { return totalBytes; }
+
     ~BufferList() {
         for (unsigned int ii = 0; ii < bufList.size(); ii++) {
-            delete[] bufList[ii];
+            Chunk &chunk = bufList[ii];
+            if (pool) {
+                pool->release(chunk.ptr, chunk.size);
+            } else {
+                delete[] chunk.ptr;
+            }
         }
     }
 
 private:
+    struct Chunk {
+        char *ptr;
+        size_t size;
+    };
+
     inline size_t bytesAvailable() {
         return bytesAllocated - bytesUsed;
     }
 
+    char *allocChunk(size_t len) {
+        Chunk chunk;
+        if (pool) {
+            chunk.ptr = pool->alloc(len, &chunk.size);
+        } else {
+            chunk.ptr = new char[len];
+            chunk.size = len;
+        }
+
+        if (chunk.ptr) {
+            bufList.push_back(chunk);
+            totalBytes += chunk.size;
+        }
+        return chunk.ptr;
+    }
 
     BufferList(BufferList& other) {
         bufList = other.bufList;
         bytesUsed = other.bytesUsed;
         bytesAllocated = other.bytesAllocated;
         curBuf = other.curBuf;
+        totalBytes = other.totalBytes;
+        pool = other.pool;
 
         other.bufList.clear();
         other.bytesUsed = 0;
         other.bytesAllocated = 0;
         other.curBuf = 0;
+        other.totalBytes = 0;
     }
 
     static const unsigned int defaultSize = 1024;
-    std::vector<char *> bufList;
+    std::vector<Chunk> bufList;
     char *curBuf;
     size_t bytesUsed;
     size_t bytesAllocated;
+    size_t totalBytes;
+    BufferPool *pool;
 
     friend class Command;
 
@@ -0,0 +1,90 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase_impl.h"
+
+namespace Couchnode
+{
+
+BufferPool::~BufferPool()
+{
+    for (int ii = 0; ii < NCLASSES; ii++) {
+        std::vector<char *> &fl = freeLists[ii];
+        for (unsigned int jj = 0; jj < fl.size(); jj++) {
+            delete[] fl[jj];
+        }
+    }
+}
+
+int BufferPool::classFor(size_t len)
+{
+    int ix = 0;
+    size_t csize = (size_t)1 << MIN_SHIFT;
+
+    while (csize < len) {
+        csize <<= 1;
+        ix++;
+    }
+
+    return ix;
+}
+
+char *BufferPool::alloc(size_t len, size_t *allocated)
+{
+    if (len > ((size_t)1 << MAX_SHIFT)) {
+        stats.unpooled++;
+        *allocated = len;
+        return new char[len];
+    }
+
+    int ix = classFor(len);
+    size_t csize = (size_t)1 << (ix + MIN_SHIFT);
+    std::vector<char *> &fl = freeLists[ix];
+    *allocated = csize;
+
+    if (!fl.empty()) {
+        char *ret = fl.back();
+        fl.pop_back();
+        stats.hits++;
+        stats.idleBytes -= csize;
+        return ret;
+    }
+
+    stats.misses++;
+    stats.residentBytes += csize;
+    return new char[csize];
+}
+
+void BufferPool::release(char *p, size_t allocated)
+{
+    if (allocated > ((size_t)1 << MAX_SHIFT)) {
+        delete[] p;
+        return;
+    }
+
+    std::vector<char *> &fl = freeLists[classFor(allocated)];
+    if ((fl.size() + 1) * allocated > maxIdleBytes) {
+        stats.residentBytes -= allocated;
+        delete[] p;
+        return;
+    }
+
+    fl.push_back(p);
+    stats.idleBytes += allocated;
+}
+
+}
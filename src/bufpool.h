@@ -0,0 +1,90 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef COUCHNODE_BUFPOOL_H
+#define COUCHNODE_BUFPOOL_H
+#include <cstdlib>
+#include <vector>
+#include <stdint.h>
+namespace Couchnode
+{
+
+/**
+ * Size-classed chunk allocator backing the BufferList objects of a single
+ * connection. Requests are rounded up to the next power of two between
+ * 64 bytes and 64KB; released chunks are kept on a free list for their
+ * class so that the next command can reuse them without going through
+ * malloc. Anything larger than the biggest class is allocated and freed
+ * directly.
+ *
+ * Commands are only ever created and destroyed on the loop thread, so the
+ * free lists are not locked.
+ */
+class BufferPool
+{
+public:
+    enum {
+        MIN_SHIFT = 6,
+        MAX_SHIFT = 16,
+        NCLASSES = MAX_SHIFT - MIN_SHIFT + 1
+    };
+
+    // Upper bound of idle bytes retained for each size class
+    static const size_t maxIdleBytes = 1024 * 1024;
+
+    struct Stats {
+        Stats() : hits(0), misses(0), unpooled(0),
+                residentBytes(0), idleBytes(0) {}
+
+        // Allocations satisfied from a free list
+        uint64_t hits;
+        // Allocations which had to go to the system allocator
+        uint64_t misses;
+        // Allocations too large for any size class
+        uint64_t unpooled;
+        // Bytes currently allocated by the pool (both in use and idle)
+        size_t residentBytes;
+        // Bytes sitting in the free lists
+        size_t idleBytes;
+    };
+
+    BufferPool() {}
+    ~BufferPool();
+
+    /**
+     * Get a chunk of at least len bytes.
+     * @param len the minimum size of the chunk
+     * @param allocated set to the actual size of the chunk. This must be
+     * passed back to release()
+     */
+    char *alloc(size_t len, size_t *allocated);
+    void release(char *p, size_t allocated);
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    static int classFor(size_t len);
+
+    std::vector<char *> freeLists[NCLASSES];
+    Stats stats;
+
+    // No copying
+    BufferPool(BufferPool&);
+};
+
+}
+#endif
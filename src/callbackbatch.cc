@@ -0,0 +1,148 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase_impl.h"
+
+namespace Couchnode
+{
+
+extern "C" {
+    static void cbbatch_close_cb(uv_handle_t *handle) {
+        delete handle;
+    }
+
+    static void cbbatch_check_cb(uv_check_t *checker, int) {
+        reinterpret_cast<CallbackBatcher *>(checker->data)->flush();
+    }
+
+    static void cbbatch_idle_cb(uv_idle_t *, int) {
+        // Only here to keep the loop from blocking while a batch waits
+    }
+}
+
+CallbackBatcher::CallbackBatcher(CouchbaseImpl *p)
+    : parent(p), enabled(false), armed(false), npending(0)
+{
+    checker = new uv_check_t;
+    uv_check_init(uv_default_loop(), checker);
+    checker->data = this;
+
+    idler = new uv_idle_t;
+    uv_idle_init(uv_default_loop(), idler);
+    idler->data = this;
+}
+
+CallbackBatcher::~CallbackBatcher()
+{
+    disarm();
+    uv_close((uv_handle_t *)checker, cbbatch_close_cb);
+    uv_close((uv_handle_t *)idler, cbbatch_close_cb);
+
+    if (!pending.IsEmpty()) {
+        pending.Dispose();
+        pending.Clear();
+    }
+}
+
+void CallbackBatcher::setEnabled(bool val)
+{
+    enabled = val;
+    if (!enabled) {
+        flush();
+    }
+}
+
+void CallbackBatcher::arm()
+{
+    if (armed) {
+        return;
+    }
+
+    uv_check_start(checker, cbbatch_check_cb);
+    uv_idle_start(idler, cbbatch_idle_cb);
+    armed = true;
+}
+
+void CallbackBatcher::disarm()
+{
+    if (!armed) {
+        return;
+    }
+
+    uv_check_stop(checker);
+    uv_idle_stop(idler);
+    armed = false;
+}
+
+void CallbackBatcher::add(Handle<Function> callback, Handle<Value> err,
+                          Handle<Value> result)
+{
+    if (result.IsEmpty()) {
+        result = v8::Undefined();
+    }
+
+    if (!enabled) {
+        // Callbacks already batched were invoked first
+        Handle<Value> args[2] = { err, result };
+        node::MakeCallback(v8::Context::GetCurrent()->Global(),
+                           callback, 2, args);
+        return;
+    }
+
+    if (pending.IsEmpty()) {
+        pending = Persistent<Array>::New(Array::New());
+    }
+
+    pending->Set(npending++, callback);
+    pending->Set(npending++, err);
+    pending->Set(npending++, result);
+    arm();
+}
+
+void CallbackBatcher::flush()
+{
+    disarm();
+    if (!npending) {
+        return;
+    }
+
+    HandleScope scope;
+    Local<Array> batch = Local<Array>::New(pending);
+    unsigned int nitems = npending;
+
+    // Callbacks may complete or issue operations, and so add to a new
+    // batch, while this one is being delivered
+    pending.Dispose();
+    pending.Clear();
+    npending = 0;
+
+    Handle<Function> handler = parent->getEventHandler("callbacks");
+    if (!handler.IsEmpty()) {
+        Handle<Value> arg = batch;
+        node::MakeCallback(v8::Context::GetCurrent()->Global(),
+                           handler, 1, &arg);
+        return;
+    }
+
+    for (unsigned int ii = 0; ii < nitems; ii += 3) {
+        Handle<Value> args[2] = { batch->Get(ii + 1), batch->Get(ii + 2) };
+        node::MakeCallback(v8::Context::GetCurrent()->Global(),
+                           batch->Get(ii).As<Function>(), 2, args);
+    }
+}
+
+}
@@ -0,0 +1,74 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef COUCHNODE_CALLBACKBATCH_H
+#define COUCHNODE_CALLBACKBATCH_H 1
+#ifndef COUCHBASE_H
+#error "include couchbase_impl.h first"
+#endif
+
+namespace Couchnode
+{
+
+class CouchbaseImpl;
+
+/**
+ * Collects the (error, result) invocations of operation callbacks made
+ * while libcouchbase processes responses, and hands them to JavaScript
+ * all at once when the current loop iteration is done with I/O. Each
+ * node::MakeCallback pays for entering JavaScript and for processing the
+ * nextTick queue on the way out; with many responses per read, this is
+ * paid once rather than once per key.
+ *
+ * The batch is passed to the 'callbacks' handler of the connection as a
+ * flat array of callback, error, result triples, in the order the
+ * responses arrived.
+ */
+class CallbackBatcher
+{
+public:
+    CallbackBatcher(CouchbaseImpl *parent);
+    ~CallbackBatcher();
+
+    bool isEnabled() const { return enabled; }
+    void setEnabled(bool val);
+
+    // Invokes the callback now if batching is disabled
+    void add(Handle<Function> callback, Handle<Value> err,
+             Handle<Value> result);
+    void flush();
+
+private:
+    void arm();
+    void disarm();
+
+    CouchbaseImpl *parent;
+    bool enabled;
+    bool armed;
+
+    Persistent<Array> pending;
+    unsigned int npending;
+
+    uv_check_t *checker;
+    uv_idle_t *idler;
+
+    // No copying
+    CallbackBatcher(CallbackBatcher&);
+};
+
+}
+
+#endif
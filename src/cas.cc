@@ -15,49 +15,96 @@
  *   limitations under the License.
  */
 #include "couchbase_impl.h"
+#include "node_buffer.h"
 #include <sstream>
 using namespace Couchnode;
 
 /**
- * If we have 64 bit pointers we can stuff the pointer into the field and
- * save on having to make a new uint64_t*
+ * CAS values are plain objects with the value split into 16 bit chunks
+ * held in internal fields. Small integers are stored inline by V8, so a
+ * CAS costs a single object allocation, with no external storage and no
+ * weak callback to run when it is collected.
+ *
+ * As before, a CAS reads as two read-only, enumerable indexed properties
+ * holding the low and high 32 bits, so that CAS values can be compared
+ * and serialized. These are computed on access by an interceptor shared
+ * by all CAS objects.
  */
-#if 0 && defined(_LP64) && !defined(COUCHNODE_NO_CASINTPTR)
-// Seems to be broken, so disabling this for now..
-Handle<Value> Cas::CreateCas(uint64_t cas)
+static const int CAS_CHUNKS = 4;
+static const int CAS_CHUNK_BITS = 16;
+static const uint32_t CAS_WORDS = 2;
+
+static Persistent<FunctionTemplate> casClass;
+
+static Handle<Value> casWordGetter(uint32_t index, const AccessorInfo &info)
 {
-    Handle<Value> ret = External::New((void*)(uintptr_t)cas);
-    return ret;
+    if (index >= CAS_WORDS) {
+        return Handle<Value>();
+    }
+
+    Handle<Object> self = info.Holder();
+    int lo = index * 2;
+    uint32_t word = self->GetInternalField(lo)->Uint32Value() |
+            (self->GetInternalField(lo + 1)->Uint32Value() << CAS_CHUNK_BITS);
+    return Integer::NewFromUnsigned(word);
 }
 
-bool Cas::GetCas(Handle<Value> obj, uint64_t *p)
+static Handle<Value> casWordSetter(uint32_t index, Local<Value> value,
+                                   const AccessorInfo &)
 {
-    if (!obj->IsExternal()) {
-        return false;
+    if (index >= CAS_WORDS) {
+        return Handle<Value>();
     }
-    *p = (uint64_t)(uintptr_t)(obj.As<External>()->Value());
-    return true;
+
+    // Read-only; the assignment is swallowed
+    return value;
+}
+
+static Handle<Integer> casWordQuery(uint32_t index, const AccessorInfo &)
+{
+    if (index >= CAS_WORDS) {
+        return Handle<Integer>();
+    }
+    return Integer::New(v8::ReadOnly | v8::DontDelete);
 }
 
-#else
+static Handle<Boolean> casWordDeleter(uint32_t index, const AccessorInfo &)
+{
+    if (index >= CAS_WORDS) {
+        return Handle<Boolean>();
+    }
+    return v8::False();
+}
 
-static void casDtor(Persistent<Value> obj, void *p) {
-    delete (uint64_t*)p;
-    obj.Dispose();
-    obj.Clear();
+static Handle<Array> casWordEnumerator(const AccessorInfo &)
+{
+    HandleScope scope;
+    Handle<Array> ret = Array::New(CAS_WORDS);
+    for (uint32_t ii = 0; ii < CAS_WORDS; ii++) {
+        ret->Set(ii, Integer::NewFromUnsigned(ii));
+    }
+    return scope.Close(ret);
 }
 
+void Cas::initialize()
+{
+    casClass = Persistent<FunctionTemplate>::New(FunctionTemplate::New());
+    casClass->SetClassName(String::NewSymbol("CouchbaseCas"));
 
-#define CAS_ARRAY_MTYPE kExternalUnsignedIntArray
-#define CAS_ARRAY_ELEMENTS 2
+    Handle<ObjectTemplate> inst = casClass->InstanceTemplate();
+    inst->SetInternalFieldCount(CAS_CHUNKS);
+    inst->SetIndexedPropertyHandler(casWordGetter, casWordSetter,
+                                    casWordQuery, casWordDeleter,
+                                    casWordEnumerator);
+}
 
 Handle<Value> Cas::CreateCas(uint64_t cas) {
-    Persistent<Object> ret = Persistent<Object>::New(Object::New());
-    uint64_t *p = new uint64_t(cas);
-    ret->SetIndexedPropertiesToExternalArrayData(p,
-                                                 CAS_ARRAY_MTYPE,
-                                                 CAS_ARRAY_ELEMENTS);
-    ret.MakeWeak(p, casDtor);
+    Handle<Object> ret = casClass->InstanceTemplate()->NewInstance();
+
+    for (int ii = 0; ii < CAS_CHUNKS; ii++) {
+        uint32_t chunk = (uint32_t)(cas >> (ii * CAS_CHUNK_BITS)) & 0xffff;
+        ret->SetInternalField(ii, Integer::NewFromUnsigned(chunk));
+    }
     return ret;
 }
 
@@ -66,12 +113,24 @@ bool Cas::GetCas(Handle<Value> obj, uint64_t *p) {
     if (!realObj->IsObject()) {
         return false;
     }
-    if (realObj->GetIndexedPropertiesExternalArrayDataLength()
-            != CAS_ARRAY_ELEMENTS) {
+
+    // A slice of the packed CAS column of a columnar getMulti
+    if (node::Buffer::HasInstance(realObj)) {
+        if (node::Buffer::Length(realObj) != sizeof(*p)) {
+            return false;
+        }
+        memcpy(p, node::Buffer::Data(realObj), sizeof(*p));
+        return true;
+    }
+
+    if (!casClass->HasInstance(realObj)) {
         return false;
     }
 
-    *p = *(uint64_t*)realObj->GetIndexedPropertiesExternalArrayData();
+    *p = 0;
+    for (int ii = 0; ii < CAS_CHUNKS; ii++) {
+        uint64_t chunk = realObj->GetInternalField(ii)->Uint32Value();
+        *p |= chunk << (ii * CAS_CHUNK_BITS);
+    }
     return true;
 }
-#endif
@@ -24,6 +24,7 @@ namespace Couchnode
 class Cas
 {
 public:
+    static void initialize();
     static bool GetCas(v8::Handle<v8::Value>, uint64_t*);
     static v8::Handle<v8::Value> CreateCas(uint64_t);
 };
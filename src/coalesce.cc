@@ -0,0 +1,233 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase_impl.h"
+
+namespace Couchnode
+{
+
+void MuxCookie::add(const void *key, size_t nkey, Cookie *target)
+{
+    targets[std::string((const char *)key, nkey)].push_back(target);
+    nremaining++;
+}
+
+Cookie *MuxCookie::resolve(const void *key, size_t nkey)
+{
+    TargetMap::iterator iter =
+            targets.find(std::string((const char *)key, nkey));
+    assert(iter != targets.end());
+
+    Cookie *ret = iter->second.front();
+    iter->second.pop_front();
+    if (iter->second.empty()) {
+        targets.erase(iter);
+    }
+
+    if (--nremaining == 0) {
+        delete this;
+    }
+    return ret;
+}
+
+extern "C" {
+    static void coalesce_close_cb(uv_handle_t *handle) {
+        delete handle;
+    }
+
+    static void coalesce_check_cb(uv_check_t *checker, int) {
+        reinterpret_cast<Coalescer *>(checker->data)->flush();
+    }
+
+    static void coalesce_idle_cb(uv_idle_t *, int) {
+        // Only here to keep the loop from blocking while a batch waits
+    }
+
+    static void coalesce_timer_cb(uv_timer_t *timer, int) {
+        reinterpret_cast<Coalescer *>(timer->data)->flush();
+    }
+}
+
+Coalescer::Coalescer(CouchbaseImpl *p)
+    : parent(p), enabled(false), armed(false), maxBatch(1024),
+      maxDelay(0), batchType(BATCH_NONE), nitems(0)
+{
+    checker = new uv_check_t;
+    uv_check_init(uv_default_loop(), checker);
+    checker->data = this;
+
+    idler = new uv_idle_t;
+    uv_idle_init(uv_default_loop(), idler);
+    idler->data = this;
+
+    timer = new uv_timer_t;
+    uv_timer_init(uv_default_loop(), timer);
+    timer->data = this;
+}
+
+Coalescer::~Coalescer()
+{
+    // Their callbacks would otherwise never be invoked
+    cancel(LCB_ERROR);
+
+    uv_close((uv_handle_t *)checker, coalesce_close_cb);
+    uv_close((uv_handle_t *)idler, coalesce_close_cb);
+    uv_close((uv_handle_t *)timer, coalesce_close_cb);
+}
+
+void Coalescer::cancel(lcb_error_t err)
+{
+    disarm();
+    if (pending.empty()) {
+        return;
+    }
+
+    HandleScope scope;
+    std::vector<Command *> cmds;
+
+    // Callbacks invoked from here may issue new commands
+    cmds.swap(pending);
+    nitems = 0;
+
+    for (unsigned int ii = 0; ii < cmds.size(); ii++) {
+        cmds[ii]->cancel(err);
+        delete cmds[ii];
+    }
+}
+
+void Coalescer::setEnabled(bool val)
+{
+    enabled = val;
+    if (!enabled) {
+        flush();
+    }
+}
+
+void Coalescer::arm()
+{
+    if (armed) {
+        return;
+    }
+
+    if (maxDelay) {
+        uv_timer_start(timer, coalesce_timer_cb, maxDelay, 0);
+    } else {
+        uv_check_start(checker, coalesce_check_cb);
+        uv_idle_start(idler, coalesce_idle_cb);
+    }
+    armed = true;
+}
+
+void Coalescer::disarm()
+{
+    if (!armed) {
+        return;
+    }
+
+    uv_timer_stop(timer);
+    uv_check_stop(checker);
+    uv_idle_stop(idler);
+    armed = false;
+}
+
+void Coalescer::add(Command *cmd)
+{
+    if (!pending.empty() && cmd->getBatchType() != batchType) {
+        flush();
+    }
+
+    batchType = cmd->getBatchType();
+    pending.push_back(cmd);
+    nitems += cmd->getKeyCount();
+
+    if (nitems >= maxBatch) {
+        flush();
+    } else {
+        arm();
+    }
+}
+
+template <typename C, typename T>
+static void collectCommands(std::vector<Command *> &cmds, MuxCookie *mux,
+                            std::vector<const T *> &out)
+{
+    for (unsigned int ii = 0; ii < cmds.size(); ii++) {
+        C *cur = static_cast<C *>(cmds[ii]);
+        CommandList<T> &cmdList = cur->getCommandList();
+
+        for (unsigned int jj = 0; jj < cmdList.size(); jj++) {
+            const T *lcmd = cmdList.getList()[jj];
+            mux->add(lcmd->v.v0.key, lcmd->v.v0.nkey, cur->getCookie());
+            out.push_back(lcmd);
+        }
+    }
+}
+
+void Coalescer::flush()
+{
+    disarm();
+    if (pending.empty()) {
+        return;
+    }
+
+    HandleScope scope;
+    lcb_t instance = parent->getLibcouchbaseHandle();
+    std::vector<Command *> cmds;
+    lcb_error_t err;
+
+    // Callbacks invoked from here may issue new commands
+    cmds.swap(pending);
+    nitems = 0;
+
+    if (cmds.size() == 1) {
+        err = cmds[0]->execute(instance);
+
+    } else {
+        MuxCookie *mux = new MuxCookie();
+
+        if (batchType == BATCH_GET) {
+            std::vector<const lcb_get_cmd_t *> list;
+            collectCommands<GetCommand>(cmds, mux, list);
+            if (list.empty()) {
+                // Every key was answered by the near cache or is
+                // already in flight
+                err = LCB_SUCCESS;
+                delete mux;
+            } else {
+                err = lcb_get(instance, mux, list.size(), &list[0]);
+            }
+
+        } else {
+            std::vector<const lcb_store_cmd_t *> list;
+            collectCommands<StoreCommand>(cmds, mux, list);
+            err = lcb_store(instance, mux, list.size(), &list[0]);
+        }
+
+        if (err != LCB_SUCCESS) {
+            delete mux;
+        }
+    }
+
+    for (unsigned int ii = 0; ii < cmds.size(); ii++) {
+        if (err != LCB_SUCCESS) {
+            cmds[ii]->cancel(err);
+        }
+        delete cmds[ii];
+    }
+}
+
+}
@@ -0,0 +1,106 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef COUCHNODE_COALESCE_H
+#define COUCHNODE_COALESCE_H 1
+#ifndef COUCHBASE_H
+#error "include couchbase_impl.h first"
+#endif
+
+#include <deque>
+
+namespace Couchnode
+{
+
+class CouchbaseImpl;
+
+/**
+ * Cookie passed to libcouchbase for a merged batch. Each response is
+ * routed back to the cookie of the operation which requested its key;
+ * several operations in a batch may share a key, in which case they
+ * receive responses in the order they were issued.
+ */
+class MuxCookie : public Cookie
+{
+public:
+    MuxCookie() : Cookie(0), nremaining(0) {}
+    void add(const void *key, size_t nkey, Cookie *target);
+    virtual Cookie *resolve(const void *key, size_t nkey);
+
+private:
+    typedef std::map<std::string, std::deque<Cookie *> > TargetMap;
+    TargetMap targets;
+    unsigned int nremaining;
+};
+
+/**
+ * Accumulates get or store commands issued during one turn of the event
+ * loop, and schedules them with a single libcouchbase call.
+ *
+ * Only one kind of command is batched at a time. A command of another
+ * kind, or one which cannot be batched at all, flushes the current batch
+ * first so that operations still reach the server in the order they were
+ * issued.
+ */
+class Coalescer
+{
+public:
+    Coalescer(CouchbaseImpl *parent);
+    ~Coalescer();
+
+    bool isEnabled() const { return enabled; }
+    void setEnabled(bool val);
+
+    unsigned int getMaxBatch() const { return maxBatch; }
+    void setMaxBatch(unsigned int val) { maxBatch = val; }
+
+    // Maximum time, in milliseconds, a command may wait in the batch. If
+    // zero, the batch is flushed once the current loop iteration is done
+    unsigned int getMaxDelay() const { return maxDelay; }
+    void setMaxDelay(unsigned int val) { maxDelay = val; }
+
+    // Takes ownership of a persistent command
+    void add(Command *cmd);
+    void flush();
+
+    // Fails the commands waiting to be sent, without sending them
+    void cancel(lcb_error_t err);
+
+private:
+    void arm();
+    void disarm();
+
+    CouchbaseImpl *parent;
+    bool enabled;
+    bool armed;
+    unsigned int maxBatch;
+    unsigned int maxDelay;
+
+    BatchType batchType;
+    std::vector<Command *> pending;
+    unsigned int nitems;
+
+    uv_check_t *checker;
+    uv_idle_t *idler;
+    uv_timer_t *timer;
+
+    // No copying
+    Coalescer(Coalescer&);
+};
+
+}
+
+#endif
@@ -101,31 +101,15 @@ bool Command::getBufBackedString(Handle<Value> v, char **k, size_t *n,
         return handleBadString("key is not a string", k, n);
     }
 
-    *n = s->Utf8Length();
-    if (!*n) {
+    if (!s->Length()) {
         return handleBadString("string is empty", k, n);
     }
 
-    if (addNul) {
-        *k = bufs.getBuffer((*n) + 1);
-    } else {
-        *k = bufs.getBuffer(*n);
-    }
-
-    if (!*k) {
+    if (!ValueFormat::writeUtf8(s, bufs, k, n, addNul)) {
         err.eMemory("Couldn't get buffer");
-    }
-
-    int nw = s->WriteUtf8(*k, *n, NULL, String::NO_NULL_TERMINATION);
-    if (nw < 0 || (unsigned int)nw < *n) {
-        err.eInternal("Incomplete conversion");
         return false;
     }
 
-    if (addNul) {
-        *(*k + *n) = '\0';
-    }
-
     return true;
 }
 
@@ -165,7 +149,11 @@ bool Command::processSingle(Handle<Value> single,
     HashkeyOption hkOpt;
     ParamSlot *spec = { &hkOpt };
 
-    if (!ParamSlot::parseAll(options.As<Object>(), &spec, 1, err)) {
+    // Scanned once here; the handler parses its own options from the
+    // same scan
+    OptionScan scan;
+    if (!scan.read(options, err) ||
+            !ParamSlot::parseAll(scan, &spec, 1, err)) {
         return false;
     }
 
@@ -185,6 +173,7 @@ bool Command::processSingle(Handle<Value> single,
 
     CommandKey ck;
     ck.setKeys(single, k, n, hashkey, nhashkey);
+    ck.setOptions(&scan);
 
     return getHandler()(this, ck, options, ix);
 }
@@ -285,6 +274,46 @@ void Command::setCookieKeyOption(Handle<Value> key, Handle<Value> option)
     cookieKeyOptions->ForceSet(key, option);
 }
 
+void Command::pinCookieValue(Handle<Value> value)
+{
+    if (cookiePinnedValues.IsEmpty()) {
+        cookiePinnedValues = Array::New();
+    }
+    cookiePinnedValues->Set(cookiePinnedValues->Length(), value);
+}
+
+void Command::addPendingWrite(const CommandKey &ki)
+{
+    if (nearCache || inflight) {
+        pendingWrites.push_back(std::string(ki.getKey(), ki.getKeySize()));
+    }
+}
+
+void Command::beginPendingWrites()
+{
+    for (unsigned int ii = 0; ii < pendingWrites.size(); ii++) {
+        const std::string &key = pendingWrites[ii];
+        if (nearCache) {
+            nearCache->beginWrite(key.data(), key.size());
+        }
+        if (inflight) {
+            inflight->invalidate(key.data(), key.size());
+        }
+    }
+}
+
+// Stands in for the responses, which will never come
+void Command::endPendingWrites()
+{
+    if (nearCache) {
+        for (unsigned int ii = 0; ii < pendingWrites.size(); ii++) {
+            const std::string &key = pendingWrites[ii];
+            nearCache->endWrite(key.data(), key.size());
+        }
+    }
+    pendingWrites.clear();
+}
+
 void Command::initCookie()
 {
     CallbackMode cbMode;
@@ -298,6 +327,10 @@ void Command::initCookie()
         cookie->setOptions(cookieKeyOptions);
     }
 
+    if (!cookiePinnedValues.IsEmpty()) {
+        cookie->setPinned(cookiePinnedValues);
+    }
+
     cookie->setCallback(callback.v, cbMode);
 }
 
@@ -310,6 +343,9 @@ Command* Command::makePersistent()
 }
 
 Command::Command(Command &other)
-    : apiArgs(other.apiArgs), cookie(other.cookie), bufs(other.bufs) {}
+    : apiArgs(other.apiArgs), cookie(other.cookie),
+      nearCache(other.nearCache), inflight(other.inflight),
+      borrowBuffers(other.borrowBuffers),
+      pendingWrites(other.pendingWrites), bufs(other.bufs) {}
 
 };
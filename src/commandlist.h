@@ -36,6 +36,7 @@ class CommandList
 public:
     bool initialize(unsigned int n) {
         ncmds = n;
+        nalloc = n;
 
         if (ncmds == 1) {
             cmds = &single_cmd;
@@ -83,14 +84,42 @@ public:
         return cmdlist;
     }
 
+    /**
+     * Leaves commands out of the list. Each must have been filled in,
+     * except those being removed
+     * @param ixs the indexes of the commands to remove, in ascending order
+     */
+    void remove(const std::vector<unsigned int> &ixs) {
+        if (ixs.empty()) {
+            return;
+        }
+
+        if (nalloc == 1) {
+            ncmds = 0;
+            return;
+        }
+
+        unsigned int nout = 0;
+        unsigned int next = 0;
+        for (unsigned int ii = 0; ii < ncmds; ii++) {
+            if (next < ixs.size() && ixs[next] == ii) {
+                next++;
+                continue;
+            }
+            cmdlist[nout++] = cmdlist[ii];
+        }
+        ncmds = nout;
+    }
+
     unsigned int size() const {
         return ncmds;
     }
 
     CommandList(CommandList& other) {
         ncmds = other.ncmds;
+        nalloc = other.nalloc;
 
-        if (ncmds < 2) {
+        if (nalloc < 2) {
             memcpy(&single_cmd, &other.single_cmd, sizeof(single_cmd));
             cmds = &single_cmd;
             cmdlist = &cmds;
@@ -102,12 +131,13 @@ public:
         other.cmds = NULL;
         other.cmdlist = NULL;
         other.ncmds = 0;
+        other.nalloc = 0;
     }
 
-    CommandList() :cmds(NULL), cmdlist(NULL), ncmds(0) {}
+    CommandList() :cmds(NULL), cmdlist(NULL), ncmds(0), nalloc(0) {}
 
     ~CommandList() {
-        if (ncmds < 2) {
+        if (nalloc < 2) {
             return;
         }
         delete[] cmds;
@@ -119,6 +149,7 @@ protected:
     T *cmds;
     T ** cmdlist;
     unsigned int ncmds;
+    unsigned int nalloc;
 };
 
 };
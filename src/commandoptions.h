@@ -34,7 +34,12 @@ namespace Couchnode {
 struct Parameters
 {
     // Pure virtual functions
-    virtual bool parseObject(const Handle<Object> obj, CBExc &) = 0;
+    virtual bool parseOptions(const OptionScan &scan, CBExc &) = 0;
+
+    bool parseObject(const Handle<Object> obj, CBExc &ex) {
+        OptionScan scan;
+        return scan.read(obj, ex) && parseOptions(scan, ex);
+    }
     bool isInitialized;
 };
 
@@ -47,7 +52,7 @@ struct GetOptions : Parameters
 
     LockOption lockTime;
     FormatOption format;
-    bool parseObject(const Handle<Object> opts, CBExc &ex);
+    bool parseOptions(const OptionScan &scan, CBExc &ex);
     void merge(const GetOptions &other);
 };
 
@@ -55,20 +60,24 @@ struct StoreOptions : Parameters
 {
     NAMED_OPTION(FormatOption, V8ValueOption, FMT_TYPE);
     NAMED_OPTION(ValueOption, V8ValueOption, VALUE);
+    NAMED_OPTION(PersistToOption, Int32Option, PERSIST_TO);
+    NAMED_OPTION(ReplicateToOption, Int32Option, REPLICATE_TO);
 
     CasSlot cas;
     ExpOption exp;
     ValueOption value;
     FlagsOption flags;
     FormatOption format;
+    PersistToOption persist_to;
+    ReplicateToOption replicate_to;
 
-    bool parseObject(const Handle<Object> opts, CBExc &ex);
+    bool parseOptions(const OptionScan &scan, CBExc &ex);
 };
 
 struct UnlockOptions : Parameters
 {
     CasSlot cas;
-    bool parseObject(const Handle<Object>, CBExc &ex);
+    bool parseOptions(const OptionScan &, CBExc &ex);
 };
 
 struct DeleteOptions : UnlockOptions
@@ -78,7 +87,7 @@ struct DeleteOptions : UnlockOptions
 struct TouchOptions : Parameters
 {
     ExpOption exp;
-    bool parseObject(const Handle<Object>, CBExc &);
+    bool parseOptions(const OptionScan &, CBExc &);
 };
 
 
@@ -95,7 +104,7 @@ struct DurabilityOptions : Parameters
     TimeoutOption timeout;
     IsDeleteOption isDelete;
 
-    bool parseObject(const Handle<Object>, CBExc &);
+    bool parseOptions(const OptionScan &, CBExc &);
 };
 
 struct ArithmeticOptions : Parameters
@@ -106,7 +115,7 @@ struct ArithmeticOptions : Parameters
     ExpOption exp;
     InitialOption initial;
     DeltaOption delta;
-    bool parseObject(const Handle<Object>, CBExc&);
+    bool parseOptions(const OptionScan &, CBExc&);
 
     void merge(const ArithmeticOptions& other);
 };
@@ -119,13 +128,18 @@ struct HttpOptions : Parameters
     NAMED_OPTION(ContentTypeOption, StringOption, HTTP_CONTENT_TYPE);
     NAMED_OPTION(MethodOption, Int32Option, HTTP_METHOD);
     NAMED_OPTION(HttpTypeOption, Int32Option, HTTP_TYPE);
+    NAMED_OPTION(StreamOption, V8ValueOption, HTTP_STREAM);
+    NAMED_OPTION(IncludeDocsOption, BooleanOption, HTTP_INCLUDE_DOCS);
 
     PathOption path;
     DataOption content;
     ContentTypeOption contentType;
     MethodOption httpMethod;
     HttpTypeOption httpType;
-    bool parseObject(const Handle<Object>, CBExc&);
+    StreamOption stream;
+    // Only meaningful for streamed view queries
+    IncludeDocsOption includeDocs;
+    bool parseOptions(const OptionScan &, CBExc&);
 };
 
 }
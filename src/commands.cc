@@ -17,6 +17,7 @@
 
 
 #include "couchbase_impl.h"
+#include <algorithm>
 namespace Couchnode
 {
 
@@ -47,13 +48,38 @@ bool GetCommand::handleSingle(Command *p,
     GetOptions kOptions;
 
     if (params.IsEmpty() == false && params->IsObject()) {
-        if (!kOptions.parseObject(params.As<Object>(), ctx->err)) {
+        if (!kOptions.parseOptions(ki.getOptions(), ctx->err)) {
             return false;
         }
     }
 
     kOptions.merge(ctx->globalOptions);
 
+    if (kOptions.lockTime.isFound()) {
+        // Locking gets must see the server's copy, and their CAS is
+        // only valid for the unlock
+        ctx->isCacheable = false;
+
+    } else if (ki.hasHashkey()) {
+        // Cached by key alone, while the same key under another hashkey
+        // may be another document
+        ctx->isCacheable = false;
+
+    } else if (!kOptions.expTime.isFound()) {
+        NearCache::Hit hit;
+        if (ctx->nearCache &&
+                ctx->nearCache->lookup(ki.getKey(), ki.getKeySize(), hit)) {
+            ctx->skippedIndexes.push_back(ix);
+            ctx->cachedHits.push_back(hit);
+            ctx->applyFormat(ki, kOptions);
+            return true;
+        }
+
+        if (ctx->inflight) {
+            ctx->sharedIndexes.push_back(ix);
+        }
+    }
+
     lcb_get_cmd_st *cmd = ctx->commands.getAt(ix);
     ki.setKeyV0(cmd);
 
@@ -65,26 +91,122 @@ bool GetCommand::handleSingle(Command *p,
         cmd->v.v0.exptime = kOptions.lockTime.v;
     }
 
+    ctx->applyFormat(ki, kOptions);
+    return true;
+}
+
+void GetCommand::applyFormat(CommandKey &ki, GetOptions &kOptions)
+{
     if (kOptions.format.isFound()) {
-        ValueFormat::Spec spec = ValueFormat::toSpec(kOptions.format.v, ctx->err);
+        ValueFormat::Spec spec = ValueFormat::toSpec(kOptions.format.v, err);
         // ignore auto so the handler uses the incoming flags
         if (spec != ValueFormat::AUTO) {
-            ctx->setCookieKeyOption(ki.getObject(), Number::New(spec));
+            setCookieKeyOption(ki.getObject(), Number::New(spec));
         }
     }
+}
+
+bool GetCommand::initialize()
+{
+    if (!Command::initialize()) {
+        return false;
+    }
 
-    return true;
+    ParamSlot *spec = &isColumnar;
+    return ParamSlot::parseAll(apiArgs[1].As<Object>(), &spec, 1, err);
+}
+
+Cookie *GetCommand::createCookie()
+{
+    if (cookie) {
+        return cookie;
+    }
+
+    if (isColumnar.isFound() && isColumnar.v) {
+        cookie = new ColumnarCookie(keys.size());
+    } else {
+        cookie = new Cookie(keys.size());
+    }
+
+    initCookie();
+
+    if (nearCache) {
+        nearCache->deliver(cookie, cachedHits);
+        if (isCacheable) {
+            cookie->setNearCache(nearCache);
+        }
+    }
+
+    if (inflight) {
+        joinInflight();
+    }
+
+    commands.remove(skippedIndexes);
+    return cookie;
+}
+
+void GetCommand::joinInflight()
+{
+    bool joined = false;
+
+    for (unsigned int ii = 0; ii < sharedIndexes.size(); ii++) {
+        unsigned int ix = sharedIndexes[ii];
+        const lcb_get_cmd_t *cmd = commands.getAt(ix);
+
+        if (inflight->join((const char *)cmd->v.v0.key, cmd->v.v0.nkey,
+                           cookie)) {
+            skippedIndexes.push_back(ix);
+            joined = true;
+        }
+    }
+
+    if (joined) {
+        std::sort(skippedIndexes.begin(), skippedIndexes.end());
+    }
+}
+
+Handle<Array> GetCommand::getKeyList()
+{
+    Handle<Array> all = Command::getKeyList();
+    if (skippedIndexes.empty()) {
+        return all;
+    }
+
+    Handle<Array> ret = Array::New(all->Length() - skippedIndexes.size());
+    unsigned int nout = 0;
+    unsigned int next = 0;
+    for (unsigned int ii = 0; ii < all->Length(); ii++) {
+        if (next < skippedIndexes.size() && skippedIndexes[next] == ii) {
+            next++;
+            continue;
+        }
+        ret->Set(nout++, all->Get(ii));
+    }
+    return ret;
+}
+
+void GetCommand::cancel(lcb_error_t err)
+{
+    // Whoever waits for our keys would otherwise never hear back
+    if (inflight) {
+        inflight->abandon(cookie, err);
+    }
+    Command::cancel(err);
 }
 
 lcb_error_t GetCommand::execute(lcb_t instance)
 {
+    if (commands.size() == 0) {
+        // Every key was answered by the near cache or is already in flight
+        return LCB_SUCCESS;
+    }
     return lcb_get(instance, cookie, commands.size(), commands.getList());
 }
 
-bool GetOptions::parseObject(const Handle<Object> options, CBExc &ex)
+bool GetOptions::parseOptions(const OptionScan &scan, CBExc &ex)
 {
     ParamSlot *specs[] = { &expTime, &lockTime, &format };
-    return ParamSlot::parseAll(options, specs, 3, ex);
+    return ParamSlot::parseAll(scan, specs, 3, ex);
 }
 
 
@@ -93,6 +215,22 @@ bool GetOptions::parseObject(const Handle<Object> options, CBExc &ex)
 /// Set                                                                      ///
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
+OpType StoreCommand::getOpType() const
+{
+    switch (op) {
+    case LCB_ADD:
+        return OP_ADD;
+    case LCB_REPLACE:
+        return OP_REPLACE;
+    case LCB_APPEND:
+        return OP_APPEND;
+    case LCB_PREPEND:
+        return OP_PREPEND;
+    default:
+        return OP_SET;
+    }
+}
+
 bool StoreCommand::handleSingle(Command *p, CommandKey &ki,
                                 Handle<Value> params, unsigned int ix)
 {
@@ -101,7 +239,7 @@ bool StoreCommand::handleSingle(Command *p, CommandKey &ki,
     StoreOptions kOptions;
 
     if (!params.IsEmpty()) {
-        if (!kOptions.parseObject(params.As<Object>(), ctx->err)) {
+        if (!kOptions.parseOptions(ki.getOptions(), ctx->err)) {
             return false;
         }
         kOptions.isInitialized = true;
@@ -114,8 +252,10 @@ bool StoreCommand::handleSingle(Command *p, CommandKey &ki,
 
     char *vbuf;
     size_t nvbuf;
+    bool borrowed = false;
     Handle<Value> s = kOptions.value.v;
     ki.setKeyV0(cmd);
+    ctx->addPendingWrite(ki);
 
     ValueFormat::Spec spec;
     Handle<Value> specObj;
@@ -131,10 +271,27 @@ bool StoreCommand::handleSingle(Command *p, CommandKey &ki,
     }
 
     if (!ValueFormat::encode(s, spec, ctx->bufs,
-                             &cmd->v.v0.flags, &vbuf, &nvbuf, ctx->err)) {
+                             &cmd->v.v0.flags, &vbuf, &nvbuf, ctx->err,
+                             ctx->borrowBuffers ? &borrowed : NULL)) {
         return false;
     }
 
+    // Explicit flags would lose the compression bit. Appended fragments
+    // are joined to the stored bytes, which keep their own flags, so
+    // neither side of the join may be compressed on its own
+    if (!kOptions.flags.isFound() &&
+            ctx->op != LCB_APPEND && ctx->op != LCB_PREPEND &&
+            ValueFormat::compress(ctx->bufs, &cmd->v.v0.flags,
+                                  &vbuf, &nvbuf)) {
+        borrowed = false;
+    }
+
+    // vbuf points into the Buffer itself; keep it alive until the
+    // operation completes in case scheduling is deferred until connect.
+    if (borrowed) {
+        ctx->pinCookieValue(s);
+    }
+
     cmd->v.v0.bytes = vbuf;
     cmd->v.v0.nbytes = nvbuf;
     cmd->v.v0.cas = kOptions.cas.v;
@@ -152,6 +309,13 @@ bool StoreCommand::handleSingle(Command *p, CommandKey &ki,
     }
 
     cmd->v.v0.operation = ctx->op;
+
+    if (kOptions.persist_to.v > ctx->persistTo) {
+        ctx->persistTo = kOptions.persist_to.v;
+    }
+    if (kOptions.replicate_to.v > ctx->replicateTo) {
+        ctx->replicateTo = kOptions.replicate_to.v;
+    }
     return true;
 }
 
@@ -160,10 +324,42 @@ lcb_error_t StoreCommand::execute(lcb_t instance)
     return lcb_store(instance, cookie, commands.size(), commands.getList());
 }
 
-bool StoreOptions::parseObject(const Handle<Object> options, CBExc &ex)
+Cookie *StoreCommand::createCookie()
 {
-    ParamSlot *spec[] = { &cas, &exp, &format, &value, &flags };
-    if (!ParamSlot::parseAll(options, spec, 5, ex)) {
+    if (cookie) {
+        return cookie;
+    }
+
+    if (globalOptions.persist_to.v > persistTo) {
+        persistTo = globalOptions.persist_to.v;
+    }
+    if (globalOptions.replicate_to.v > replicateTo) {
+        replicateTo = globalOptions.replicate_to.v;
+    }
+
+    if (isDurable()) {
+        lcb_durability_opts_t dopts;
+        memset(&dopts, 0, sizeof(dopts));
+        dopts.v.v0.persist_to = persistTo;
+        dopts.v.v0.replicate_to = replicateTo;
+        if (persistTo < 1 || replicateTo < 1) {
+            dopts.v.v0.cap_max = 1;
+        }
+        cookie = new DurableCookie(keys.size(), dopts);
+    } else {
+        cookie = new Cookie(keys.size());
+    }
+
+    initCookie();
+    return cookie;
+}
+
+bool StoreOptions::parseOptions(const OptionScan &scan, CBExc &ex)
+{
+    ParamSlot *spec[] = {
+            &cas, &exp, &format, &value, &flags, &persist_to, &replicate_to
+    };
+    if (!ParamSlot::parseAll(scan, spec, 7, ex)) {
         return false;
     }
 
@@ -175,10 +371,10 @@ bool StoreOptions::parseObject(const Handle<Object> options, CBExc &ex)
 /// Arithmetic                                                               ///
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-bool ArithmeticOptions::parseObject(const Handle<Object> obj, CBExc &ex)
+bool ArithmeticOptions::parseOptions(const OptionScan &scan, CBExc &ex)
 {
     ParamSlot *spec[] = { &this->exp, &initial, &delta };
-    return ParamSlot::parseAll(obj, spec, 3, ex);
+    return ParamSlot::parseAll(scan, spec, 3, ex);
 }
 
 void ArithmeticOptions::merge(const ArithmeticOptions &other)
@@ -205,7 +401,7 @@ bool ArithmeticCommand::handleSingle(Command *p, CommandKey &ki,
 
 
     if (!params.IsEmpty()) {
-        if (!kOptions.parseObject(params.As<Object>(), ctx->err)) {
+        if (!kOptions.parseOptions(ki.getOptions(), ctx->err)) {
             return false;
         }
         kOptions.isInitialized = true;
@@ -214,6 +410,7 @@ bool ArithmeticCommand::handleSingle(Command *p, CommandKey &ki,
 
     kOptions.merge(ctx->globalOptions);
     ki.setKeyV0(cmd);
+    ctx->addPendingWrite(ki);
     cmd->v.v0.delta = kOptions.delta.v;
     cmd->v.v0.initial = kOptions.initial.v;
     if (kOptions.initial.isFound()) {
@@ -242,7 +439,7 @@ bool DeleteCommand::handleSingle(Command *p, CommandKey &ki,
     DeleteOptions kOptions;
 
     if (!params.IsEmpty()) {
-        if (!kOptions.parseObject(params.As<Object>(), ctx->err)) {
+        if (!kOptions.parseOptions(ki.getOptions(), ctx->err)) {
             return false;
         }
         effectiveOptions = &kOptions;
@@ -252,6 +449,7 @@ bool DeleteCommand::handleSingle(Command *p, CommandKey &ki,
 
     lcb_remove_cmd_t *cmd = ctx->commands.getAt(ix);
     ki.setKeyV0(cmd);
+    ctx->addPendingWrite(ki);
     cmd->v.v0.cas = effectiveOptions->cas.v;
     return true;
 }
@@ -266,10 +464,10 @@ lcb_error_t DeleteCommand::execute(lcb_t instance)
 /// Unlock                                                                   ///
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-bool UnlockOptions::parseObject(const Handle<Object> obj, CBExc &ex)
+bool UnlockOptions::parseOptions(const OptionScan &scan, CBExc &ex)
 {
     ParamSlot *spec = &cas;
-    return ParamSlot::parseAll(obj, &spec, 1, ex);
+    return ParamSlot::parseAll(scan, &spec, 1, ex);
 }
 
 bool UnlockCommand::handleSingle(Command *p, CommandKey& ki,
@@ -282,7 +480,7 @@ bool UnlockCommand::handleSingle(Command *p, CommandKey& ki,
         return false;
     }
 
-    if (!kOptions.parseObject(params.As<Object>(), ctx->err)) {
+    if (!kOptions.parseOptions(ki.getOptions(), ctx->err)) {
         return false;
     }
 
@@ -307,10 +505,10 @@ lcb_error_t UnlockCommand::execute(lcb_t instance)
 /// Touch                                                                    ///
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-bool TouchOptions::parseObject(const Handle<Object> obj, CBExc &ex)
+bool TouchOptions::parseOptions(const OptionScan &scan, CBExc &ex)
 {
     ParamSlot *spec = &this->exp;
-    return ParamSlot::parseAll(obj, &spec, 1, ex);
+    return ParamSlot::parseAll(scan, &spec, 1, ex);
 }
 
 bool TouchCommand::handleSingle(Command *p, CommandKey &ki,
@@ -319,7 +517,7 @@ bool TouchCommand::handleSingle(Command *p, CommandKey &ki,
     TouchCommand *ctx = static_cast<TouchCommand *>(p);
     TouchOptions kOptions;
     if (!params.IsEmpty()) {
-        if (!kOptions.parseObject(params.As<Object>(), ctx->err)) {
+        if (!kOptions.parseOptions(ki.getOptions(), ctx->err)) {
             return false;
         }
     } else {
@@ -374,12 +572,12 @@ Cookie *ObserveCommand::createCookie()
 /// Endure                                                                   ///
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-bool DurabilityOptions::parseObject(Handle<Object> params, CBExc &ex)
+bool DurabilityOptions::parseOptions(const OptionScan &scan, CBExc &ex)
 {
     ParamSlot *specs[] = {
             &persist_to, &replicate_to, &isDelete, &timeout
     };
-    return ParamSlot::parseAll(params, specs, 4, ex);
+    return ParamSlot::parseAll(scan, specs, 4, ex);
 }
 
 bool EndureCommand::handleSingle(Command *p, CommandKey &ki,
@@ -393,7 +591,7 @@ bool EndureCommand::handleSingle(Command *p, CommandKey &ki,
 
         CasSlot casSlot;
         ParamSlot *spec = &casSlot;
-        if (!ParamSlot::parseAll(params.As<Object>(), &spec, 1, ctx->err)) {
+        if (!ParamSlot::parseAll(ki.getOptions(), &spec, 1, ctx->err)) {
             return false;
         }
         if (casSlot.isFound()) {
@@ -461,13 +659,14 @@ lcb_error_t StatsCommand::execute(lcb_t instance)
 /// HTTP                                                                     ///
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-bool HttpOptions::parseObject(const Handle<Object> obj, CBExc &ex)
+bool HttpOptions::parseOptions(const OptionScan &scan, CBExc &ex)
 {
     ParamSlot *spec[] = {
-            &path, &content, &contentType, &httpMethod, &httpType
+            &path, &content, &contentType, &httpMethod, &httpType, &stream,
+            &includeDocs
     };
 
-    return ParamSlot::parseAll(obj, spec, 5, ex);
+    return ParamSlot::parseAll(scan, spec, 7, ex);
 }
 
 bool HttpCommand::handleSingle(Command *p, CommandKey &ki,
@@ -545,6 +744,11 @@ bool HttpCommand::handleSingle(Command *p, CommandKey &ki,
         cmd->v.v0.body = kMisc;
         cmd->v.v0.nbody = nMisc;
     }
+
+    // Streamed responses are delivered as they arrive
+    if (options->stream.isFound() && options->stream.v->IsObject()) {
+        cmd->v.v0.chunked = 1;
+    }
     return true;
 }
 
@@ -562,7 +766,13 @@ Cookie *HttpCommand::createCookie()
     if (cookie) {
         return cookie;
     }
-    cookie = new HttpCookie();
+    if (globalOptions.stream.isFound() &&
+            globalOptions.stream.v->IsObject()) {
+        cookie = new ViewRowCookie(globalOptions.stream.v.As<Object>(),
+                                   globalOptions.includeDocs.v);
+    } else {
+        cookie = new HttpCookie();
+    }
     cookie->setCallback(callback.v, CBMODE_SINGLE);
     return cookie;
 }
@@ -33,6 +33,13 @@ enum ArgMode {
     ARGMODE_MULTI = 0x2,
 };
 
+// Kinds of commands which may be merged into a single libcouchbase call
+enum BatchType {
+    BATCH_NONE = 0,
+    BATCH_GET,
+    BATCH_STORE
+};
+
 
 #define CTOR_COMMON(cls) \
         cls(const Arguments &args, int mode) : Command(args, mode) {}
@@ -77,6 +84,11 @@ public:
         nhashkey = nhk;
     }
 
+    // The per-key options, already scanned for the hashkey
+    void setOptions(const OptionScan *scan) {
+        options = scan;
+    }
+
     template <typename T>
     void setKeyV0(T *cmd) {
         cmd->v.v0.key = key;
@@ -86,9 +98,10 @@ public:
     }
 
     const char *getKey() const { return key; }
+    bool hasHashkey() const { return hashkey != NULL; }
     size_t getKeySize() const { return nkey; }
     Handle<Value> getObject() const { return object; }
-
+    const OptionScan &getOptions() const { return *options; }
 
 private:
     Handle<Value> object;
@@ -96,6 +109,7 @@ private:
     size_t nkey;
     const char *hashkey;
     size_t nhashkey;
+    const OptionScan *options;
 };
 
 class Command
@@ -121,6 +135,9 @@ public:
     Command(const Arguments& args, int cmdMode) : apiArgs(args) {
         mode = cmdMode;
         cookie = NULL;
+        nearCache = NULL;
+        inflight = NULL;
+        borrowBuffers = false;
     }
 
     virtual ~Command() {
@@ -147,10 +164,43 @@ public:
     Command *makePersistent();
     void detachCookie() { cookie = NULL; }
 
-    Handle<Array> getKeyList() {
+    // The keys to cancel should scheduling fail
+    virtual Handle<Array> getKeyList() {
         return keys.getSafeKeysArray();
     }
 
+    // Fails the keys of this command, which could not be scheduled
+    virtual void cancel(lcb_error_t err) {
+        endPendingWrites();
+        cookie->cancel(err, getKeyList());
+    }
+
+    unsigned int getKeyCount() const { return keys.size(); }
+
+    // Memory held for the keys and values of this command
+    size_t getBufferBytes() const { return bufs.getTotalBytes(); }
+    virtual BatchType getBatchType() const { return BATCH_NONE; }
+    virtual OpType getOpType() const { return OP_NONE; }
+
+    // Draw key and value buffers from a connection-wide pool
+    void setBufferPool(BufferPool *pool) { bufs.setPool(pool); }
+
+    // Store Buffer values from their own memory rather than a copy. The
+    // caller must then leave them unmodified until the operation is done
+    void setBorrowBuffers(bool val) { borrowBuffers = val; }
+
+    // Answer gets from, and fill, the connection's near cache
+    void setNearCache(NearCache *cache) { nearCache = cache; }
+
+    // Keeps the near cache off the keys this command mutates from now
+    // until their responses, and stops later gets of them from sharing a
+    // fetch already in flight, so that gets issued after it are not
+    // answered with what it replaces
+    void beginPendingWrites();
+
+    // Share the responses to gets of keys already being fetched
+    void setInflightGets(InflightGets *table) { inflight = table; }
+
 protected:
     bool getBufBackedString(Handle<Value> v, char **k, size_t *n,
                             bool addNul = false);
@@ -162,6 +212,9 @@ protected:
     virtual const char *getDefaultString() const { return NULL; }
     void initCookie();
     void setCookieKeyOption(Handle<Value> key, Handle<Value> option);
+    void pinCookieValue(Handle<Value> value);
+    void addPendingWrite(const CommandKey &ki);
+    void endPendingWrites();
     Command(Command &other);
 
     const Arguments& apiArgs;
@@ -175,6 +228,13 @@ protected:
     HashkeyOption globalHashkey;
 
     Cookie *cookie;
+    NearCache *nearCache;
+    InflightGets *inflight;
+    bool borrowBuffers;
+
+    // Keys mutated by this command, while the near cache or get
+    // deduplication is enabled
+    std::vector<std::string> pendingWrites;
 
     CBExc err;
     KeysInfo keys;
@@ -184,6 +244,9 @@ protected:
     // these are transferred over to the the cookie when needed
     Handle<Object> cookieKeyOptions;
 
+    // Values whose storage is referenced directly by the commands
+    Handle<Array> cookiePinnedValues;
+
 
     // Set by subclasses:
     int mode; // MODE_* | MODE_* ...
@@ -200,17 +263,42 @@ class GetCommand : public Command
 {
 
 public:
-    CTOR_COMMON(GetCommand)
+    GetCommand(const Arguments &args, int mode)
+        : Command(args, mode), isCacheable(true) {}
+    bool initialize();
     lcb_error_t execute(lcb_t);
     static bool handleSingle(Command *,
                              CommandKey&, Handle<Value>, unsigned int);
 
     virtual Command* copy() { return new GetCommand(*this); }
+    virtual Cookie *createCookie();
+    virtual Handle<Array> getKeyList();
+    virtual void cancel(lcb_error_t err);
+    virtual BatchType getBatchType() const { return BATCH_GET; }
+    virtual OpType getOpType() const { return OP_GET; }
+    CommandList<lcb_get_cmd_t>& getCommandList() { return commands; }
 
 protected:
+    NAMED_OPTION(ColumnarOption, BooleanOption, COLUMNAR);
+
     Parameters* getParams() { return &globalOptions; }
     GetOptions globalOptions;
+    ColumnarOption isColumnar;
     CommandList<lcb_get_cmd_t> commands;
+
+    // Keys not fetched by this command, by index: those answered by the
+    // near cache, with their values, and those already being fetched.
+    // The responses to the other keys are cached unless a key is locked
+    // or has a hashkey
+    std::vector<unsigned int> skippedIndexes;
+    std::vector<NearCache::Hit> cachedHits;
+    bool isCacheable;
+
+    // Keys which may share the response to a get already in flight
+    std::vector<unsigned int> sharedIndexes;
+
+    void applyFormat(CommandKey &ki, GetOptions &kOptions);
+    void joinInflight();
     ItemHandler getHandler() const { return handleSingle; }
     virtual bool initCommandList() {
         return commands.initialize(keys.size());
@@ -231,6 +319,8 @@ public:
         globalOptions.lockTime.forceIsFound();
         return true;
     }
+
+    virtual OpType getOpType() const { return OP_LOCK; }
 };
 
 
@@ -238,16 +328,29 @@ class StoreCommand : public Command
 {
 public:
     StoreCommand(const Arguments& origArgs, lcb_storage_t sop, int mode)
-        : Command(origArgs, mode), op(sop) { }
+        : Command(origArgs, mode), op(sop), persistTo(0), replicateTo(0) { }
 
     static bool handleSingle(Command*, CommandKey&,
                              Handle<Value>, unsigned int);
 
     lcb_error_t execute(lcb_t);
     virtual Command* copy() { return new StoreCommand(*this); }
+    virtual Cookie *createCookie();
+    virtual BatchType getBatchType() const {
+        // Durable stores are polled with their own cookie
+        return isDurable() ? BATCH_NONE : BATCH_STORE;
+    }
+    virtual OpType getOpType() const;
+    CommandList<lcb_store_cmd_t>& getCommandList() { return commands; }
 
 protected:
+    bool isDurable() const { return persistTo > 0 || replicateTo > 0; }
+
     lcb_storage_t op;
+    // The strongest durability requirement of any key, as the keys are
+    // all polled at once
+    int persistTo;
+    int replicateTo;
     CommandList<lcb_store_cmd_t> commands;
     StoreOptions globalOptions;
     ItemHandler getHandler() const { return handleSingle; }
@@ -262,6 +365,7 @@ class UnlockCommand : public Command
 public:
     CTOR_COMMON(UnlockCommand)
     virtual Command *copy() { return new UnlockCommand(*this); }
+    virtual OpType getOpType() const { return OP_UNLOCK; }
     lcb_error_t execute(lcb_t);
 
 protected:
@@ -285,6 +389,7 @@ public:
                              Handle<Value>, unsigned int);
     lcb_error_t execute(lcb_t);
     virtual Command *copy() { return new TouchCommand(*this); }
+    virtual OpType getOpType() const { return OP_TOUCH; }
 
 protected:
     CommandList<lcb_touch_cmd_t> commands;
@@ -303,6 +408,7 @@ public:
     CTOR_COMMON(ArithmeticCommand)
     lcb_error_t execute(lcb_t);
     Command * copy() { return new ArithmeticCommand(*this); }
+    virtual OpType getOpType() const { return OP_ARITHMETIC; }
 protected:
     static bool handleSingle(Command *, CommandKey&,
                              Handle<Value>, unsigned int);
@@ -322,6 +428,7 @@ public:
     CTOR_COMMON(DeleteCommand)
     lcb_error_t execute(lcb_t);
     Command *copy() { return new DeleteCommand(*this); }
+    virtual OpType getOpType() const { return OP_REMOVE; }
 
 protected:
     static bool handleSingle(Command *, CommandKey&,
@@ -360,6 +467,7 @@ public:
     CTOR_COMMON(EndureCommand)
     lcb_error_t execute(lcb_t);
     Command *copy() { return new EndureCommand(*this); };
+    virtual OpType getOpType() const { return OP_ENDURE; }
 
 protected:
     CommandList<lcb_durability_cmd_t> commands;
@@ -31,16 +31,43 @@ Handle<Object> CouchbaseImpl::createConstants()
     X(CNTL_LIBCOUCHBASE_VERSION) \
     X(CNTL_CLNODES) \
     X(CNTL_RESTURI) \
+    X(CNTL_BUFPOOL_STATS) \
+    X(CNTL_NATIVE_JSON) \
+    X(CNTL_COALESCE) \
+    X(CNTL_COALESCE_MAXBATCH) \
+    X(CNTL_COALESCE_MAXDELAY) \
+    X(CNTL_PENDING_LIMIT) \
+    X(CNTL_PENDING_FAILFAST) \
+    X(CNTL_PENDING_STATS) \
+    X(CNTL_LATENCY_TRACKING) \
+    X(CNTL_LATENCY) \
+    X(CNTL_GC_STATS) \
+    X(CNTL_VBMAP_MULTI) \
+    X(CNTL_OUTSTANDING) \
+    X(CNTL_JSON_OFFLOAD) \
+    X(CNTL_COMPRESSION) \
+    X(CNTL_CALLBACK_BATCHING) \
+    X(CNTL_SHARED_ERRORS) \
+    X(CNTL_NEAR_CACHE_SIZE) \
+    X(CNTL_NEAR_CACHE_TTL) \
+    X(CNTL_NEAR_CACHE_STATS) \
+    X(CNTL_GET_DEDUP) \
+    X(CNTL_GET_DEDUP_JOINED) \
+    X(CNTL_BORROW_BUFFERS) \
+    X(CNTL_LAZY_VALUES) \
+    X(CNTL_DECOMPRESSION) \
     X(ErrorCode::MEMORY) \
     X(ErrorCode::ARGUMENTS) \
     X(ErrorCode::SCHEDULING) \
     X(ErrorCode::CHECK_RESULTS) \
     X(ErrorCode::GENERIC) \
     X(ErrorCode::DURABILITY_FAILED) \
+    X(ErrorCode::QUEUE_FULL) \
     X(ValueFormat::AUTO) \
     X(ValueFormat::RAW) \
     X(ValueFormat::UTF8) \
-    X(ValueFormat::JSON)
+    X(ValueFormat::JSON) \
+    X(ValueFormat::COMPRESSED)
 
 #define X(n) \
     define_constant(o, #n, n);
@@ -114,6 +114,65 @@ Handle<Value> CouchbaseImpl::_Control(const Arguments &args)
         return scope.Close(arr);
      }
 
+    case CNTL_VBMAP_MULTI: {
+        if (!optVal->IsArray()) {
+            return exc.eArguments("Expected an array of keys").throwV8();
+        }
+
+        RoutingTable *routing = me->getRoutingTable();
+        Handle<Array> keys = optVal.As<Array>();
+        unsigned int nkeys = keys->Length();
+
+        Handle<Object> global = v8::Context::GetCurrent()->Global();
+        Handle<Function> u32Ctor =
+                global->Get(String::NewSymbol("Uint32Array")).As<Function>();
+        Handle<Function> i32Ctor =
+                global->Get(String::NewSymbol("Int32Array")).As<Function>();
+        Handle<Value> len = Integer::NewFromUnsigned(nkeys);
+        Handle<Object> vbuckets = u32Ctor->NewInstance(1, &len);
+        Handle<Object> servers = i32Ctor->NewInstance(1, &len);
+
+        uint32_t *vbOut = NULL;
+        int32_t *srvOut = NULL;
+        if (nkeys) {
+            vbOut = static_cast<uint32_t *>(
+                    vbuckets->GetIndexedPropertiesExternalArrayData());
+            srvOut = static_cast<int32_t *>(
+                    servers->GetIndexedPropertiesExternalArrayData());
+        }
+
+        std::vector<char> keybuf;
+        for (unsigned int ii = 0; ii < nkeys; ii++) {
+            Handle<String> key = keys->Get(ii)->ToString();
+            keybuf.resize(key->Length() * 3 + 1);
+            int nkey = key->WriteUtf8(&keybuf[0], keybuf.size(), NULL,
+                                      String::NO_NULL_TERMINATION);
+
+            int vb, srv;
+            err = routing->map(instance, &keybuf[0], nkey, &vb, &srv);
+            if (err != LCB_SUCCESS) {
+                return exc.eLcb(err).throwV8();
+            }
+            vbOut[ii] = vb;
+            srvOut[ii] = srv;
+        }
+
+        const std::vector<std::string> &hostList =
+                routing->getServers(instance);
+        Handle<Array> hosts = Array::New(hostList.size());
+        for (unsigned int ii = 0; ii < hostList.size(); ii++) {
+            hosts->Set(ii, String::New(hostList[ii].c_str()));
+        }
+
+        Handle<Object> ret = Object::New();
+        ret->Set(String::NewSymbol("vbuckets"), vbuckets);
+        ret->Set(String::NewSymbol("servers"), servers);
+        ret->Set(String::NewSymbol("hosts"), hosts);
+        ret->Set(String::NewSymbol("generation"),
+                 Integer::NewFromUnsigned(routing->getGeneration()));
+        return scope.Close(ret);
+    }
+
     case CNTL_LIBCOUCHBASE_VERSION: {
         const char *vstr;
         lcb_uint32_t vnum;
@@ -152,6 +211,290 @@ Handle<Value> CouchbaseImpl::_Control(const Arguments &args)
         return scope.Close(String::New(s));
     }
 
+    case CNTL_BUFPOOL_STATS: {
+        const BufferPool::Stats &stats = me->getBufferPool()->getStats();
+        Handle<Object> ret = Object::New();
+        ret->Set(String::NewSymbol("hits"), Number::New(stats.hits));
+        ret->Set(String::NewSymbol("misses"), Number::New(stats.misses));
+        ret->Set(String::NewSymbol("unpooled"), Number::New(stats.unpooled));
+        ret->Set(String::NewSymbol("resident"),
+                 Number::New(stats.residentBytes));
+        ret->Set(String::NewSymbol("idle"), Number::New(stats.idleBytes));
+        return scope.Close(ret);
+    }
+
+    case CNTL_NATIVE_JSON: {
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(Integer::NewFromUnsigned(
+                    ValueFormat::nativeJson));
+        }
+
+        ValueFormat::nativeJson = optVal->Uint32Value() &
+                (ValueFormat::NATIVE_JSON_ENCODE |
+                        ValueFormat::NATIVE_JSON_DECODE);
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_JSON_OFFLOAD: {
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(Number::New(ValueFormat::offloadThreshold));
+        }
+
+        ValueFormat::offloadThreshold = optVal->Uint32Value();
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_COMPRESSION: {
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(Number::New(ValueFormat::compressThreshold));
+        }
+
+        ValueFormat::compressThreshold = optVal->Uint32Value();
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_DECOMPRESSION: {
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(v8::Boolean::New(ValueFormat::decompress));
+        }
+
+        ValueFormat::decompress = optVal->BooleanValue();
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_LAZY_VALUES: {
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(v8::Boolean::New(me->getLazyValues()));
+        }
+        me->setLazyValues(optVal->BooleanValue());
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_BORROW_BUFFERS: {
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(v8::Boolean::New(me->getBorrowBuffers()));
+        }
+        me->setBorrowBuffers(optVal->BooleanValue());
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_SHARED_ERRORS: {
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(v8::Boolean::New(me->getSharedErrors()));
+        }
+        me->setSharedErrors(optVal->BooleanValue());
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_NEAR_CACHE_SIZE: {
+        NearCache &cache = me->getNearCache();
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(Number::New(cache.getMaxBytes()));
+        }
+        cache.setMaxBytes(optVal->IntegerValue());
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_NEAR_CACHE_TTL: {
+        NearCache &cache = me->getNearCache();
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(Integer::NewFromUnsigned(cache.getTtl()));
+        }
+        cache.setTtl(optVal->Uint32Value());
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_GET_DEDUP: {
+        InflightGets &inflight = me->getInflightGets();
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(v8::Boolean::New(inflight.isEnabled()));
+        }
+        inflight.setEnabled(optVal->BooleanValue());
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_GET_DEDUP_JOINED:
+        return scope.Close(Number::New(
+                me->getInflightGets().getJoinedCount()));
+
+    case CNTL_NEAR_CACHE_STATS: {
+        NearCache &cache = me->getNearCache();
+        if (option == LCB_CNTL_SET) {
+            cache.resetStats();
+            err = LCB_SUCCESS;
+            break;
+        }
+
+        const NearCache::Stats &stats = cache.getStats();
+        Handle<Object> ret = Object::New();
+        ret->Set(String::NewSymbol("hits"), Number::New(stats.hits));
+        ret->Set(String::NewSymbol("misses"), Number::New(stats.misses));
+        ret->Set(String::NewSymbol("expired"), Number::New(stats.expired));
+        ret->Set(String::NewSymbol("evictions"),
+                 Number::New(stats.evictions));
+        ret->Set(String::NewSymbol("invalidations"),
+                 Number::New(stats.invalidations));
+        ret->Set(String::NewSymbol("entries"),
+                 Number::New(cache.getEntryCount()));
+        ret->Set(String::NewSymbol("bytes"), Number::New(cache.getBytes()));
+        return scope.Close(ret);
+    }
+
+    case CNTL_PENDING_LIMIT: {
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(Integer::NewFromUnsigned(
+                    me->getPendingLimit()));
+        }
+        me->setPendingLimit(optVal->Uint32Value());
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_PENDING_FAILFAST: {
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(v8::Boolean::New(me->getPendingFailFast()));
+        }
+        me->setPendingFailFast(optVal->BooleanValue());
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_PENDING_STATS: {
+        Handle<Object> ret = Object::New();
+        ret->Set(String::NewSymbol("depth"),
+                 Number::New(me->getPendingCount()));
+        ret->Set(String::NewSymbol("bytes"),
+                 Number::New(me->getPendingBytes()));
+        return scope.Close(ret);
+    }
+
+    case CNTL_OUTSTANDING:
+        return scope.Close(Number::New(me->getOutstandingCount()));
+
+    case CNTL_LATENCY_TRACKING: {
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(v8::Boolean::New(me->isTrackingLatency()));
+        }
+        me->setLatencyTracking(optVal->BooleanValue());
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_LATENCY: {
+        LatencyTracker *tracker = me->getLatencyTracker();
+
+        if (option == LCB_CNTL_SET) {
+            if (tracker) {
+                tracker->reset();
+            }
+            err = LCB_SUCCESS;
+            break;
+        }
+
+        // Durations are reported in microseconds
+        Handle<Object> ret = Object::New();
+        for (int ii = 0; tracker && ii < OP_MAX; ii++) {
+            const LatencyHistogram &hist = tracker->get((OpType)ii);
+            if (!hist.getCount()) {
+                continue;
+            }
+
+            Handle<Object> opStats = Object::New();
+            opStats->Set(String::NewSymbol("count"),
+                         Number::New(hist.getCount()));
+            opStats->Set(String::NewSymbol("min"),
+                         Number::New(hist.getMin() / 1000.0));
+            opStats->Set(String::NewSymbol("max"),
+                         Number::New(hist.getMax() / 1000.0));
+            opStats->Set(String::NewSymbol("mean"),
+                         Number::New(hist.getMean() / 1000.0));
+            opStats->Set(String::NewSymbol("p50"),
+                         Number::New(hist.getPercentile(0.5) / 1000.0));
+            opStats->Set(String::NewSymbol("p90"),
+                         Number::New(hist.getPercentile(0.9) / 1000.0));
+            opStats->Set(String::NewSymbol("p99"),
+                         Number::New(hist.getPercentile(0.99) / 1000.0));
+            opStats->Set(String::NewSymbol("p999"),
+                         Number::New(hist.getPercentile(0.999) / 1000.0));
+
+            ret->Set(String::NewSymbol(
+                    LatencyTracker::getOpName((OpType)ii)), opStats);
+        }
+        return scope.Close(ret);
+    }
+
+    case CNTL_GC_STATS: {
+        if (option == LCB_CNTL_SET) {
+            GcStats::reset();
+            err = LCB_SUCCESS;
+            break;
+        }
+
+        GcStats::Snapshot snap;
+        GcStats::getSnapshot(&snap);
+
+        Handle<Object> ret = Object::New();
+        ret->Set(String::NewSymbol("count"), Number::New(snap.count));
+        ret->Set(String::NewSymbol("pauseMs"),
+                 Number::New(snap.pauseTime / 1000000.0));
+        ret->Set(String::NewSymbol("allocated"),
+                 Number::New(snap.allocated));
+        ret->Set(String::NewSymbol("heapUsed"), Number::New(snap.heapUsed));
+        return scope.Close(ret);
+    }
+
+    case CNTL_COALESCE: {
+        Coalescer *coalescer = me->getCoalescer();
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(v8::Boolean::New(coalescer->isEnabled()));
+        }
+        coalescer->setEnabled(optVal->BooleanValue());
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_CALLBACK_BATCHING: {
+        CallbackBatcher *batcher = me->getCallbackBatcher();
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(v8::Boolean::New(batcher->isEnabled()));
+        }
+        batcher->setEnabled(optVal->BooleanValue());
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_COALESCE_MAXBATCH: {
+        Coalescer *coalescer = me->getCoalescer();
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(Integer::NewFromUnsigned(
+                    coalescer->getMaxBatch()));
+        }
+        coalescer->setMaxBatch(optVal->Uint32Value());
+        err = LCB_SUCCESS;
+        break;
+    }
+
+    case CNTL_COALESCE_MAXDELAY: {
+        Coalescer *coalescer = me->getCoalescer();
+        if (option == LCB_CNTL_GET) {
+            return scope.Close(Integer::NewFromUnsigned(
+                    coalescer->getMaxDelay()));
+        }
+        coalescer->setMaxDelay(optVal->Uint32Value());
+        err = LCB_SUCCESS;
+        break;
+    }
+
 
     default:
         return exc.eArguments("Not supported yet").throwV8();
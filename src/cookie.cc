@@ -16,13 +16,19 @@
  */
 
 #include "couchbase_impl.h"
+#include "node_buffer.h"
 #include <cstdio>
+#include <cstring>
 #include <sstream>
 
 using namespace Couchnode;
 
 Cookie::~Cookie()
 {
+    if (outstanding) {
+        (*outstanding)--;
+    }
+
     if (!parent.IsEmpty()) {
         parent.Dispose();
         parent.Clear();
@@ -42,6 +48,11 @@ Cookie::~Cookie()
         keyOptions.Dispose();
         keyOptions.Clear();
     }
+
+    if (!pinned.IsEmpty()) {
+        pinned.Dispose();
+        pinned.Clear();
+    }
 }
 
 void Cookie::addSpooledInfo(Handle<Value>& ec, ResponseInfo& info)
@@ -58,8 +69,25 @@ void Cookie::addSpooledInfo(Handle<Value>& ec, ResponseInfo& info)
     spooledInfo->ForceSet(info.getKey(), payload);
 }
 
+void Cookie::invokeCallback(Handle<Value> err, Handle<Value> result)
+{
+    if (batcher) {
+        batcher->add(callback, err, result);
+        return;
+    }
+
+    Handle<Value> args[2] = { err, result };
+    node::MakeCallback(v8::Context::GetCurrent()->Global(),
+                       callback, 2, args);
+}
+
 void Cookie::invokeSingleCallback(Handle<Value>& errObj, ResponseInfo& info)
 {
+    if (batcher) {
+        batcher->add(callback, errObj, info.payload);
+        return;
+    }
+
     Handle<Value> args[2] = { errObj, info.payload };
     int argc = 2;
     if (args[1].IsEmpty()) {
@@ -70,22 +98,22 @@ void Cookie::invokeSingleCallback(Handle<Value>& errObj, ResponseInfo& info)
                        callback, argc, args);
 }
 
-void Cookie::invokeSpooledCallback()
+Handle<Value> Cookie::getSpooledError()
 {
-    Handle<Value> globalErr;
-    if (hasError) {
-        CBExc ex;
-        ex.assign(ErrorCode::CHECK_RESULTS,
-                  "At least one of your operations failed, check the results"
-                  " object for more information.");
-        globalErr = ex.asValue();
-    } else {
-        globalErr = v8::Undefined();
+    if (!hasError) {
+        return v8::Undefined();
     }
 
-    Handle<Value> args[2] = { globalErr, spooledInfo };
-    node::MakeCallback(v8::Context::GetCurrent()->Global(),
-                       callback, 2, args);
+    CBExc ex;
+    ex.assign(ErrorCode::CHECK_RESULTS,
+              "At least one of your operations failed, check the results"
+              " object for more information.");
+    return ex.asValue();
+}
+
+void Cookie::invokeSpooledCallback()
+{
+    invokeCallback(getSpooledError(), spooledInfo);
 }
 
 bool Cookie::hasRemaining() {
@@ -97,6 +125,10 @@ void Cookie::markProgress(ResponseInfo &info) {
     remaining--;
     Handle<Value> errObj;
 
+    if (!isCancelled) {
+        recordLatency();
+    }
+
     if (isCancelled == false && info.hasKey() == false) {
         // Termination via 'NULL'
         if (cbType == CBMODE_SPOOLED) {
@@ -107,7 +139,11 @@ void Cookie::markProgress(ResponseInfo &info) {
 
     if (info.status != LCB_SUCCESS) {
         hasError = true;
-        errObj = CBExc().eLcb(info.status).asValue();
+        if (info.error.IsEmpty()) {
+            errObj = errorValue(info.status);
+        } else {
+            errObj = info.error;
+        }
     } else {
         errObj = v8::Undefined();
     }
@@ -137,6 +173,248 @@ void Cookie::cancel(lcb_error_t err, Handle<Array> keys)
     }
 }
 
+void Cookie::onGetResponse(lcb_error_t err, const lcb_get_resp_t *resp)
+{
+    ResponseInfo ri(err, resp, this);
+    if (ri.deferDecode) {
+        // Reported once the value has been decoded
+        JsonDecodeJob::schedule(this, resp, ri.deferFlags, ri.payload);
+        return;
+    }
+    markProgress(ri);
+}
+
+void Cookie::onStoreResponse(lcb_t, lcb_error_t err,
+                             const lcb_store_resp_t *resp)
+{
+    ResponseInfo ri(err, resp);
+    markProgress(ri);
+}
+
+void Cookie::onDurabilityResponse(lcb_error_t err,
+                                  const lcb_durability_resp_t *resp)
+{
+    ResponseInfo ri(err, resp);
+    markProgress(ri);
+}
+
+DurableCookie::DurableCookie(unsigned int ncmds,
+                             const lcb_durability_opts_t &opts)
+    : Cookie(ncmds), options(opts), nstores(ncmds)
+{
+    stored = Persistent<Object>::New(Object::New());
+    storedKeys.reserve(ncmds);
+    storedCas.reserve(ncmds);
+}
+
+DurableCookie::~DurableCookie()
+{
+    stored.Dispose();
+    stored.Clear();
+}
+
+void DurableCookie::onStoreResponse(lcb_t instance, lcb_error_t err,
+                                    const lcb_store_resp_t *resp)
+{
+    ResponseInfo ri(err, resp);
+    nstores--;
+
+    if (err != LCB_SUCCESS) {
+        // Poll first: reporting the last key may destroy this cookie
+        if (nstores == 0 && !storedKeys.empty()) {
+            poll(instance);
+        }
+        markProgress(ri);
+        return;
+    }
+
+    stored->ForceSet(ri.getKey(), ri.payload);
+    storedKeys.push_back(std::string((const char *)ri.key, ri.nkey));
+    storedCas.push_back(resp->v.v0.cas);
+
+    if (nstores == 0) {
+        poll(instance);
+    }
+}
+
+void DurableCookie::setDurabilityError(ResponseInfo &ri)
+{
+    // Single callbacks get the error for the whole operation, which
+    // must still tell that the store itself succeeded
+    if (cbType != CBMODE_SINGLE) {
+        return;
+    }
+
+    CBExc ex;
+    ex.assign(ErrorCode::DURABILITY_FAILED, "Durability requirements failed");
+    Handle<Object> errObj = ex.asValue().As<Object>();
+    errObj->Set(String::NewSymbol("innerError"),
+                CBExc().eLcb(ri.status).asValue());
+    ri.error = errObj;
+}
+
+Handle<Object> DurableCookie::takeStored(Handle<Value> key)
+{
+    Handle<Object> ret = stored->Get(key).As<Object>();
+    stored->ForceDelete(key);
+    return ret;
+}
+
+void DurableCookie::poll(lcb_t instance)
+{
+    std::vector<lcb_durability_cmd_t> cmds(storedKeys.size());
+    std::vector<const lcb_durability_cmd_t *> cmdPtrs(storedKeys.size());
+
+    for (unsigned int ii = 0; ii < storedKeys.size(); ii++) {
+        memset(&cmds[ii], 0, sizeof(cmds[ii]));
+        cmds[ii].v.v0.key = storedKeys[ii].data();
+        cmds[ii].v.v0.nkey = storedKeys[ii].size();
+        cmds[ii].v.v0.cas = storedCas[ii];
+        cmdPtrs[ii] = &cmds[ii];
+    }
+
+    lcb_error_t err = lcb_durability_poll(instance, this, &options,
+                                          cmdPtrs.size(), &cmdPtrs[0]);
+    if (err == LCB_SUCCESS) {
+        return;
+    }
+
+    // Copy the keys, as the last markProgress() destroys this cookie
+    std::vector<std::string> keys(storedKeys);
+    for (unsigned int ii = 0; ii < keys.size(); ii++) {
+        Handle<Value> key = String::New(keys[ii].data(), keys[ii].size());
+        ResponseInfo ri(err, key);
+        ri.key = keys[ii].data();
+        ri.nkey = keys[ii].size();
+        ri.payload = takeStored(key);
+        setDurabilityError(ri);
+        markProgress(ri);
+    }
+}
+
+void DurableCookie::onDurabilityResponse(lcb_error_t err,
+                                         const lcb_durability_resp_t *resp)
+{
+    ResponseInfo ri(err, resp);
+    ri.payload = takeStored(ri.getKey());
+
+    if (ri.status != LCB_SUCCESS) {
+        setDurabilityError(ri);
+    }
+    markProgress(ri);
+}
+
+ColumnarCookie::ColumnarCookie(unsigned int ncmds)
+    : Cookie(ncmds), total(ncmds), nresults(0), flags(NULL),
+      casValues(NULL)
+{
+    HandleScope scope;
+
+    Handle<Function> u32Ctor = v8::Context::GetCurrent()->Global()->Get(
+            String::NewSymbol("Uint32Array")).As<Function>();
+    Handle<Value> len = Integer::NewFromUnsigned(ncmds);
+    Handle<Object> flagsArray = u32Ctor->NewInstance(1, &len);
+    node::Buffer *casBuf = node::Buffer::New(ncmds * 8);
+
+    if (ncmds) {
+        flags = static_cast<uint32_t *>(
+                flagsArray->GetIndexedPropertiesExternalArrayData());
+        casValues = node::Buffer::Data(casBuf);
+        memset(casValues, 0, ncmds * 8);
+    }
+
+    keys = Persistent<Array>::New(Array::New(ncmds));
+    values = Persistent<Array>::New(Array::New(ncmds));
+
+    result = Persistent<Object>::New(Object::New());
+    result->ForceSet(NameMap::names[NameMap::COL_KEYS], keys);
+    result->ForceSet(NameMap::names[NameMap::COL_VALUES], values);
+    result->ForceSet(NameMap::names[NameMap::FLAGS], flagsArray);
+    result->ForceSet(NameMap::names[NameMap::CAS], casBuf->handle_);
+}
+
+ColumnarCookie::~ColumnarCookie()
+{
+    result.Dispose();
+    result.Clear();
+    keys.Dispose();
+    keys.Clear();
+    values.Dispose();
+    values.Clear();
+
+    if (!errors.IsEmpty()) {
+        errors.Dispose();
+        errors.Clear();
+    }
+}
+
+void ColumnarCookie::addResult(Handle<Value> key, lcb_error_t err,
+                               const lcb_get_resp_t *resp)
+{
+    unsigned int ix = nresults++;
+    keys->Set(ix, key);
+
+    if (resp) {
+        recordLatency();
+    }
+
+    if (err != LCB_SUCCESS) {
+        hasError = true;
+        // Only created when needed, as most bulk reads succeed
+        if (errors.IsEmpty()) {
+            errors = Persistent<Array>::New(Array::New(total));
+            result->ForceSet(NameMap::names[NameMap::COL_ERRORS], errors);
+        }
+        errors->Set(ix, errorValue(err));
+
+    } else {
+        uint32_t effectiveFlags = resp->v.v0.flags;
+        lcb_cas_t cas = resp->v.v0.cas;
+
+        flags[ix] = resp->v.v0.flags;
+        memcpy(casValues + ix * 8, &cas, 8);
+
+        if (hasKeyOptions()) {
+            Handle<Value> kOpt = getKeyOption(key);
+            if (!kOpt.IsEmpty()) {
+                // The format is overridden, not the compression
+                effectiveFlags = kOpt->Uint32Value() |
+                        (resp->v.v0.flags & ValueFormat::COMPRESSED);
+            }
+        }
+
+        values->Set(ix, ValueFormat::decode((const char *)resp->v.v0.bytes,
+                                            resp->v.v0.nbytes,
+                                            effectiveFlags));
+    }
+
+    if (nresults == total) {
+        invoke();
+    }
+}
+
+void ColumnarCookie::invoke()
+{
+    invokeCallback(getSpooledError(), result);
+    delete this;
+}
+
+void ColumnarCookie::onGetResponse(lcb_error_t err,
+                                   const lcb_get_resp_t *resp)
+{
+    HandleScope scope;
+    addResult(String::New((const char *)resp->v.v0.key, resp->v.v0.nkey),
+              err, resp);
+}
+
+void ColumnarCookie::cancel(lcb_error_t err, Handle<Array> keyList)
+{
+    unsigned int nkeys = keyList->Length();
+    for (unsigned int ii = 0; ii < nkeys; ii++) {
+        addResult(keyList->Get(ii), err, NULL);
+    }
+}
+
 void StatsCookie::invoke(lcb_error_t err)
 {
     HandleScope scope;
@@ -213,28 +491,44 @@ void HttpCookie::update(lcb_error_t err, const lcb_http_resp_t *resp)
         return;
     }
 
+    complete(err, resp->v.v0.status,
+             (const char *)resp->v.v0.bytes, resp->v.v0.nbytes,
+             (const char *)resp->v.v0.path, resp->v.v0.npath);
+}
+
+void HttpCookie::complete(lcb_error_t err, int status,
+                          const char *bytes, size_t nbytes,
+                          const char *path, size_t npath)
+{
+    HandleScope scope;
+    Handle<Value> errObj;
+
+    if (err) {
+        errObj = CBExc().eLcb(err).asValue();
+    } else {
+        errObj = v8::Undefined();
+    }
+
     Handle<Object> payload = Object::New();
     payload->ForceSet(NameMap::names[NameMap::HTTP_STATUS],
-                      Number::New(resp->v.v0.status));
+                      Number::New(status));
 
     if (err != LCB_SUCCESS) {
         payload->ForceSet(NameMap::names[NameMap::ERR], errObj);
     }
 
-    if (resp->v.v0.nbytes) {
-        Handle<Value> body = String::New((const char *)resp->v.v0.bytes,
-                                          resp->v.v0.nbytes);
+    if (nbytes) {
+        Handle<Value> body = String::New(bytes, nbytes);
         if (body.IsEmpty()) {
             // binary?
-            body = node::Encode(resp->v.v0.bytes, resp->v.v0.nbytes);
+            body = node::Encode(bytes, nbytes);
         }
         payload->ForceSet(NameMap::names[NameMap::HTTP_CONTENT], body);
     }
 
-    if (resp->v.v0.path) {
+    if (path) {
         payload->ForceSet(NameMap::names[NameMap::HTTP_PATH],
-                          String::New((const char *)resp->v.v0.path,
-                                      resp->v.v0.npath));
+                          String::New(path, npath));
     }
 
     Handle<Value> args[] = { errObj, payload };
@@ -243,6 +537,335 @@ void HttpCookie::update(lcb_error_t err, const lcb_http_resp_t *resp)
     delete this;
 }
 
+Persistent<Function> ViewRowCookie::flowControlFn;
+
+void ViewRowCookie::initialize()
+{
+    flowControlFn = Persistent<Function>::New(
+            FunctionTemplate::New(FlowControl)->GetFunction());
+}
+
+ViewRowCookie::ViewRowCookie(Handle<Object> s, bool docs)
+    : instance(NULL), includeDocs(docs), paused(false), emitting(false),
+      completed(false), finalErr(LCB_SUCCESS), status(0)
+{
+    stream = Persistent<Object>::New(s);
+    stream->SetHiddenValue(NameMap::names[NameMap::HTTP_STREAM],
+                           External::New(this));
+    stream->Set(String::NewSymbol("_flowControl"), flowControlFn);
+}
+
+ViewRowCookie::~ViewRowCookie()
+{
+    // Only destroyed once every batch has been delivered
+    assert(docBatches.empty());
+
+    // Calls to _flowControl after this point are ignored
+    stream->DeleteHiddenValue(NameMap::names[NameMap::HTTP_STREAM]);
+    stream.Dispose();
+    stream.Clear();
+}
+
+Handle<Value> ViewRowCookie::FlowControl(const Arguments &args)
+{
+    HandleScope scope;
+    Handle<Value> cookie = args.This()->GetHiddenValue(
+            NameMap::names[NameMap::HTTP_STREAM]);
+
+    if (!cookie.IsEmpty() && cookie->IsExternal()) {
+        ViewRowCookie *me = reinterpret_cast<ViewRowCookie *>(
+                cookie.As<External>()->Value());
+        me->setPaused(args.Length() > 0 && args[0]->BooleanValue());
+    }
+    return scope.Close(v8::Undefined());
+}
+
+void ViewRowCookie::setPaused(bool val)
+{
+    paused = val;
+    if (!paused) {
+        emitRows();
+    }
+}
+
+void ViewRowCookie::onData(lcb_t lcb, lcb_error_t,
+                           const lcb_http_resp_t *resp)
+{
+    instance = lcb;
+    status = resp->v.v0.status;
+    parser.feed((const char *)resp->v.v0.bytes, resp->v.v0.nbytes);
+    emitRows();
+}
+
+Handle<Value> ViewRowCookie::takeRows()
+{
+    HandleScope scope;
+    Handle<Value> rows;
+    std::string text;
+    JsonTape tape;
+
+    parser.takeRows(text, maxBatch);
+
+    if (tape.parse(text.data(), text.size()) == JsonTape::PARSE_OK) {
+        rows = tape.materialize();
+    } else {
+        Handle<Value> s = String::New(text.data(), text.size());
+        rows = ValueFormat::jsonParse->Call(
+                v8::Context::GetCurrent()->Global(), 1, &s);
+    }
+    return scope.Close(rows);
+}
+
+void ViewRowCookie::deliver(Handle<Value> rows)
+{
+    node::MakeCallback(stream, "_onRows", 1, &rows);
+}
+
+void ViewRowCookie::emitRows()
+{
+    // A handler may resume the stream from within _onRows
+    if (emitting) {
+        return;
+    }
+    emitting = true;
+
+    bool progress = true;
+    while (!paused && progress) {
+        progress = false;
+
+        // Deliver the batches whose documents are all in, in order
+        while (!paused && !docBatches.empty() &&
+               docBatches.front()->isDone()) {
+            HandleScope scope;
+            ViewDocsCookie *batch = docBatches.front();
+            docBatches.pop_front();
+
+            Handle<Value> rows = Local<Array>::New(batch->getRows());
+            delete batch;
+            deliver(rows);
+            progress = true;
+        }
+
+        if (paused || !parser.getRowCount()) {
+            break;
+        }
+
+        if (includeDocs) {
+            if (docBatches.size() >= maxDocBatches) {
+                break;
+            }
+
+            HandleScope scope;
+            Handle<Value> rows = takeRows();
+            progress = true;
+            if (rows.IsEmpty() || !rows->IsArray()) {
+                continue;
+            }
+
+            ViewDocsCookie *batch = new ViewDocsCookie(this,
+                                                       rows.As<Array>());
+            docBatches.push_back(batch);
+            batch->schedule(instance);
+
+        } else {
+            HandleScope scope;
+            Handle<Value> rows = takeRows();
+            if (!rows.IsEmpty()) {
+                deliver(rows);
+            }
+            progress = true;
+        }
+    }
+
+    emitting = false;
+    if (completed && !parser.getRowCount() && docBatches.empty()) {
+        finish();
+    }
+}
+
+void ViewRowCookie::update(lcb_error_t err, const lcb_http_resp_t *resp)
+{
+    if (!resp) {
+        // Cancellation
+        HttpCookie::update(err, resp);
+        return;
+    }
+
+    status = resp->v.v0.status;
+    finalErr = err;
+    completed = true;
+
+    if (!emitting && !parser.getRowCount() && docBatches.empty()) {
+        finish();
+    }
+    // Otherwise finished once the queued rows have been delivered
+}
+
+void ViewRowCookie::finish()
+{
+    const std::string &meta = parser.getMeta();
+    complete(finalErr, status, meta.data(), meta.size(), NULL, 0);
+}
+
+ViewDocsCookie::ViewDocsCookie(ViewRowCookie *o, Handle<Array> r)
+    : Cookie(0), owner(o), nremaining(0)
+{
+    rows = Persistent<Array>::New(r);
+
+    Handle<String> idName = NameMap::names[NameMap::VIEW_ROW_ID];
+    for (unsigned int ii = 0; ii < r->Length(); ii++) {
+        Handle<Value> row = r->Get(ii);
+        if (!row->IsObject()) {
+            continue;
+        }
+
+        Handle<Value> id = row.As<Object>()->Get(idName);
+        if (!id->IsString()) {
+            continue;
+        }
+
+        String::Utf8Value idStr(id);
+        ids[std::string(*idStr, idStr.length())].push_back(ii);
+    }
+}
+
+ViewDocsCookie::~ViewDocsCookie()
+{
+    rows.Dispose();
+    rows.Clear();
+}
+
+void ViewDocsCookie::schedule(lcb_t instance)
+{
+    if (ids.empty()) {
+        return;
+    }
+
+    std::vector<lcb_get_cmd_t> cmds(ids.size());
+    std::vector<const lcb_get_cmd_t *> cmdPtrs(ids.size());
+
+    unsigned int ii = 0;
+    for (IdMap::iterator it = ids.begin(); it != ids.end(); ++it, ++ii) {
+        memset(&cmds[ii], 0, sizeof(cmds[ii]));
+        cmds[ii].v.v0.key = it->first.data();
+        cmds[ii].v.v0.nkey = it->first.size();
+        cmdPtrs[ii] = &cmds[ii];
+    }
+
+    lcb_error_t err = LCB_EINTERNAL;
+    if (instance) {
+        err = lcb_get(instance, this, cmdPtrs.size(), &cmdPtrs[0]);
+    }
+
+    if (err != LCB_SUCCESS) {
+        // The rows are delivered without their documents
+        for (IdMap::iterator it = ids.begin(); it != ids.end(); ++it) {
+            setDoc(it->first, v8::Null());
+        }
+        return;
+    }
+    nremaining = ids.size();
+}
+
+void ViewDocsCookie::setDoc(const std::string &id, Handle<Value> doc)
+{
+    IdMap::iterator it = ids.find(id);
+    if (it == ids.end()) {
+        return;
+    }
+
+    Handle<String> docName = NameMap::names[NameMap::VIEW_ROW_DOC];
+    std::vector<unsigned int> &indexes = it->second;
+    for (unsigned int ii = 0; ii < indexes.size(); ii++) {
+        rows->Get(indexes[ii]).As<Object>()->ForceSet(docName, doc);
+    }
+}
+
+static std::string toBase64(const char *bytes, size_t n)
+{
+    static const char chars[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const unsigned char *in = (const unsigned char *)bytes;
+    std::string ret;
+    ret.reserve((n + 2) / 3 * 4);
+
+    for (size_t ii = 0; ii < n; ii += 3) {
+        uint32_t triple = in[ii] << 16;
+        if (ii + 1 < n) {
+            triple |= in[ii + 1] << 8;
+        }
+        if (ii + 2 < n) {
+            triple |= in[ii + 2];
+        }
+
+        ret += chars[(triple >> 18) & 0x3f];
+        ret += chars[(triple >> 12) & 0x3f];
+        ret += ii + 1 < n ? chars[(triple >> 6) & 0x3f] : '=';
+        ret += ii + 2 < n ? chars[triple & 0x3f] : '=';
+    }
+    return ret;
+}
+
+/**
+ * A document in the form the view engine returns it with include_docs:
+ * its metadata, and its body as 'json' if it parses as JSON, or as
+ * 'base64' otherwise. A get does not report the revision or the expiration which the
+ * engine includes in the metadata; the CAS is given instead.
+ */
+static Handle<Value> makeViewDoc(const lcb_get_resp_t *resp)
+{
+    HandleScope scope;
+    const char *bytes = (const char *)resp->v.v0.bytes;
+    size_t nbytes = resp->v.v0.nbytes;
+    uint32_t flags = resp->v.v0.flags;
+
+    Handle<Object> meta = Object::New();
+    meta->Set(NameMap::names[NameMap::VIEW_ROW_ID],
+              String::New((const char *)resp->v.v0.key, resp->v.v0.nkey));
+    meta->Set(NameMap::names[NameMap::CAS], Cas::CreateCas(resp->v.v0.cas));
+    meta->Set(NameMap::names[NameMap::FLAGS], Uint32::New(flags));
+
+    Handle<Object> doc = Object::New();
+    doc->Set(String::NewSymbol("meta"), meta);
+
+    // Like the engine, whatever the format in the flags: UTF-8 strings
+    // and transcoded values which hold JSON text are returned as JSON.
+    // Falls back to a Buffer if the value is not valid JSON
+    uint32_t compressed = ValueFormat::isCompressed(flags) ?
+            ValueFormat::COMPRESSED : 0;
+    Handle<Value> body = ValueFormat::decode(bytes, nbytes,
+                                             ValueFormat::JSON | compressed);
+
+    if (node::Buffer::HasInstance(body)) {
+        Handle<Object> buf = body.As<Object>();
+        std::string encoded = toBase64(node::Buffer::Data(buf),
+                                       node::Buffer::Length(buf));
+        doc->Set(String::NewSymbol("base64"),
+                 String::New(encoded.data(), encoded.size()));
+    } else {
+        doc->Set(String::NewSymbol("json"), body);
+    }
+    return scope.Close(doc);
+}
+
+void ViewDocsCookie::onGetResponse(lcb_error_t err,
+                                   const lcb_get_resp_t *resp)
+{
+    HandleScope scope;
+    Handle<Value> doc = v8::Null();
+
+    if (err == LCB_SUCCESS) {
+        doc = makeViewDoc(resp);
+    }
+
+    setDoc(std::string((const char *)resp->v.v0.key, resp->v.v0.nkey), doc);
+
+    if (--nremaining == 0) {
+        // May deliver (and delete) this batch
+        owner->onDocsReady();
+    }
+}
+
 void ObserveCookie::update(lcb_error_t err, const lcb_observe_resp_t *resp)
 {
     ResponseInfo ri(err, resp);
@@ -269,43 +892,190 @@ void ObserveCookie::update(lcb_error_t err, const lcb_observe_resp_t *resp)
 }
 
 
+Persistent<ObjectTemplate> ResponseInfo::shapes[ResponseInfo::SHAPE_MAX];
+
+// Internal fields of lazy get results: the value, or its encoded bytes
+// and their flags until it is first read
+enum {
+    LAZY_VALUE_DATA,
+    LAZY_VALUE_FLAGS,
+    LAZY_VALUE_NFIELDS
+};
+
+static Handle<Value> lazyValueGetter(Local<String>, const AccessorInfo &info)
+{
+    HandleScope scope;
+    Handle<Object> self = info.Holder();
+    Handle<Value> data = self->GetInternalField(LAZY_VALUE_DATA);
+    Handle<Value> flags = self->GetInternalField(LAZY_VALUE_FLAGS);
+
+    if (flags->IsUndefined()) {
+        return scope.Close(data);
+    }
+
+    Handle<Object> bytes = data.As<Object>();
+    Handle<Value> value = ValueFormat::decode(node::Buffer::Data(bytes),
+                                              node::Buffer::Length(bytes),
+                                              flags->Uint32Value());
+
+    // Later reads return the same value
+    self->SetInternalField(LAZY_VALUE_DATA, value);
+    self->SetInternalField(LAZY_VALUE_FLAGS, v8::Undefined());
+    return scope.Close(value);
+}
+
+static void lazyValueSetter(Local<String>, Local<Value> value,
+                            const AccessorInfo &info)
+{
+    Handle<Object> self = info.Holder();
+    self->SetInternalField(LAZY_VALUE_DATA, value);
+    self->SetInternalField(LAZY_VALUE_FLAGS, v8::Undefined());
+}
+
+static Handle<ObjectTemplate> makeShape(const NameMap::dict_t *fields,
+                                        size_t nfields)
+{
+    Handle<ObjectTemplate> ret = ObjectTemplate::New();
+    for (size_t ii = 0; ii < nfields; ii++) {
+        ret->Set(NameMap::names[fields[ii]], v8::Undefined());
+    }
+    return ret;
+}
+
+void ResponseInfo::initialize()
+{
+    HandleScope scope;
+
+    static const NameMap::dict_t getFields[] = {
+        NameMap::CAS, NameMap::FLAGS, NameMap::VALUE
+    };
+    static const NameMap::dict_t casFields[] = {
+        NameMap::CAS
+    };
+    static const NameMap::dict_t arithFields[] = {
+        NameMap::CAS, NameMap::VALUE
+    };
+    static const NameMap::dict_t observeFields[] = {
+        NameMap::OBS_CODE, NameMap::CAS, NameMap::OBS_ISMASTER,
+        NameMap::OBS_TTP, NameMap::OBS_TTR
+    };
+    static const NameMap::dict_t durabilityFields[] = {
+        NameMap::DUR_FOUND_MASTER, NameMap::DUR_PERSISTED_MASTER,
+        NameMap::DUR_NPERSISTED, NameMap::DUR_NREPLICATED, NameMap::CAS
+    };
+
+    Handle<ObjectTemplate> lazy = makeShape(getFields, 2);
+    lazy->SetInternalFieldCount(LAZY_VALUE_NFIELDS);
+    lazy->SetAccessor(NameMap::names[NameMap::VALUE],
+                      lazyValueGetter, lazyValueSetter);
+
+    shapes[SHAPE_GET] = Persistent<ObjectTemplate>::New(
+            makeShape(getFields, 3));
+    shapes[SHAPE_GET_LAZY] = Persistent<ObjectTemplate>::New(lazy);
+    shapes[SHAPE_CAS] = Persistent<ObjectTemplate>::New(
+            makeShape(casFields, 1));
+    shapes[SHAPE_ARITHMETIC] = Persistent<ObjectTemplate>::New(
+            makeShape(arithFields, 2));
+    shapes[SHAPE_OBSERVE] = Persistent<ObjectTemplate>::New(
+            makeShape(observeFields, 5));
+    shapes[SHAPE_DURABILITY] = Persistent<ObjectTemplate>::New(
+            makeShape(durabilityFields, 5));
+}
+
+/**
+ * Failed operations have no fields besides the error, so only successful
+ * ones are created with their shape
+ */
 template <typename T>
-void initCommonInfo_v0(ResponseInfo *tp, lcb_error_t err, const T* resp)
+void ResponseInfo::initCommon(lcb_error_t err, const T* resp, Shape shape)
 {
-    tp->key = resp->v.v0.key;
-    tp->nkey = resp->v.v0.nkey;
-    tp->status = err;
-    tp->payload = Object::New();
+    key = resp->v.v0.key;
+    nkey = resp->v.v0.nkey;
+    status = err;
+    deferDecode = false;
+
+    if (err == LCB_SUCCESS) {
+        payload = newPayload(shape);
+    } else {
+        payload = Object::New();
+    }
 }
 
 ResponseInfo::ResponseInfo(lcb_error_t err, const lcb_get_resp_t *resp,
                            const Cookie *cookie)
+    : key(resp->v.v0.key), nkey(resp->v.v0.nkey), deferDecode(false)
 {
-    initCommonInfo_v0(this, err, resp);
+    status = err;
     if (err != LCB_SUCCESS) {
+        payload = Object::New();
         return;
     }
 
     uint32_t effectiveFlags = resp->v.v0.flags;
-    setCas(resp->v.v0.cas);
-    setField(NameMap::FLAGS, Uint32::New(resp->v.v0.flags));
-
     if (cookie->hasKeyOptions()) {
         Handle<Value> kOpt = const_cast<Cookie*>(cookie)->getKeyOption(getKey());
         if (!kOpt.IsEmpty()) {
-            effectiveFlags = kOpt->Uint32Value();
+            // The format is overridden, not the compression
+            effectiveFlags = kOpt->Uint32Value() |
+                    (resp->v.v0.flags & ValueFormat::COMPRESSED);
         }
     }
 
+    // Parsing JSON is expensive, and some callers only want the CAS or
+    // the flags. Deferring it costs a copy of the bytes, so is only done
+    // when asked. Anything else is a plain copy and gains nothing from
+    // being deferred
+    uint32_t format = effectiveFlags;
+    if (ValueFormat::isCompressed(effectiveFlags)) {
+        format &= ~ValueFormat::COMPRESSED;
+    }
+    bool isLazy = false;
+    if (format == ValueFormat::JSON && resp->v.v0.nbytes) {
+        if (ValueFormat::offloadThreshold &&
+                resp->v.v0.nbytes >= ValueFormat::offloadThreshold) {
+            deferDecode = true;
+            deferFlags = effectiveFlags;
+        } else {
+            isLazy = cookie->hasLazyValues();
+        }
+    }
+
+    payload = newPayload(isLazy ? SHAPE_GET_LAZY : SHAPE_GET);
+    setCas(resp->v.v0.cas);
+    setField(NameMap::FLAGS, Uint32::New(resp->v.v0.flags));
+
+    if (isLazy) {
+        setLazyValue((const char *)resp->v.v0.bytes, resp->v.v0.nbytes,
+                     effectiveFlags);
+        return;
+    }
+
+    if (deferDecode) {
+        return;
+    }
+
     Handle<Value> s = ValueFormat::decode((const char *)resp->v.v0.bytes,
                                           resp->v.v0.nbytes,
                                           effectiveFlags);
     setValue(s);
 }
 
+void ResponseInfo::setLazyValue(const char *bytes, size_t nbytes,
+                                uint32_t flags)
+{
+    // The response buffer is only valid during the callback, so keep a
+    // copy of the encoded bytes instead. These may be any bytes at all,
+    // and a Buffer reports its size to the GC and frees it when collected
+    // 0.8 defines this as char*, hence the cast
+    node::Buffer *data = node::Buffer::New(const_cast<char*>(bytes), nbytes);
+
+    payload->SetInternalField(LAZY_VALUE_DATA, data->handle_);
+    payload->SetInternalField(LAZY_VALUE_FLAGS, Uint32::New(flags));
+}
+
 ResponseInfo::ResponseInfo(lcb_error_t err, const lcb_store_resp_t *resp)
 {
-    initCommonInfo_v0(this, err, resp);
+    initCommon(err, resp, SHAPE_CAS);
     if (err != LCB_SUCCESS) {
         return;
     }
@@ -314,7 +1084,7 @@ ResponseInfo::ResponseInfo(lcb_error_t err, const lcb_store_resp_t *resp)
 
 ResponseInfo::ResponseInfo(lcb_error_t err, const lcb_arithmetic_resp_t *resp)
 {
-    initCommonInfo_v0(this, err, resp);
+    initCommon(err, resp, SHAPE_ARITHMETIC);
     if (err != LCB_SUCCESS) {
         return;
     }
@@ -326,7 +1096,7 @@ ResponseInfo::ResponseInfo(lcb_error_t err, const lcb_arithmetic_resp_t *resp)
 
 ResponseInfo::ResponseInfo(lcb_error_t err, const lcb_touch_resp_t *resp)
 {
-    initCommonInfo_v0(this, err, resp);
+    initCommon(err, resp, SHAPE_CAS);
     if (err != LCB_SUCCESS) {
         return;
     }
@@ -335,12 +1105,16 @@ ResponseInfo::ResponseInfo(lcb_error_t err, const lcb_touch_resp_t *resp)
 
 ResponseInfo::ResponseInfo(lcb_error_t err, const lcb_unlock_resp_t *resp)
 {
-    initCommonInfo_v0(this, err, resp);
+    key = resp->v.v0.key;
+    nkey = resp->v.v0.nkey;
+    status = err;
+    deferDecode = false;
+    payload = Object::New();
 }
 
 ResponseInfo::ResponseInfo(lcb_error_t err, const lcb_remove_resp_t *resp)
 {
-    initCommonInfo_v0(this, err, resp);
+    initCommon(err, resp, SHAPE_CAS);
     if (err != LCB_SUCCESS) {
         return;
     }
@@ -370,43 +1144,37 @@ ResponseInfo::ResponseInfo(lcb_error_t err, const lcb_observe_resp_t *resp)
         return;
     }
 
-    initCommonInfo_v0(this, err, resp);
+    // The fields are set whatever the status
+    initCommon(LCB_SUCCESS, resp, SHAPE_OBSERVE);
+    status = err;
     setField(NameMap::OBS_CODE, Number::New(resp->v.v0.status));
-
     setCas(resp->v.v0.cas);
-
-    if (resp->v.v0.from_master) {
-        setField(NameMap::OBS_ISMASTER, v8::True());
-    }
-
+    setField(NameMap::OBS_ISMASTER,
+             v8::Boolean::New(resp->v.v0.from_master != 0));
     setField(NameMap::OBS_TTP, Number::New(resp->v.v0.ttp));
     setField(NameMap::OBS_TTR, Number::New(resp->v.v0.ttr));
 }
 
 ResponseInfo::ResponseInfo(lcb_error_t err, const lcb_durability_resp_t *resp)
 {
+    // The fields are set whatever the status
+    initCommon(LCB_SUCCESS, resp, SHAPE_DURABILITY);
     status = err;
-    initCommonInfo_v0(this, err, resp);
     if (err == LCB_SUCCESS) {
         status = resp->v.v0.err;
     }
 
-    if (resp->v.v0.exists_master) {
-        setField(NameMap::DUR_FOUND_MASTER, v8::True());
-    }
-
-    if (resp->v.v0.persisted_master) {
-        setField(NameMap::DUR_PERSISTED_MASTER, v8::True());
-    }
-
+    setField(NameMap::DUR_FOUND_MASTER,
+             v8::Boolean::New(resp->v.v0.exists_master != 0));
+    setField(NameMap::DUR_PERSISTED_MASTER,
+             v8::Boolean::New(resp->v.v0.persisted_master != 0));
     setField(NameMap::DUR_NPERSISTED, Number::New(resp->v.v0.npersisted));
     setField(NameMap::DUR_NREPLICATED, Number::New(resp->v.v0.nreplicated));
-
     setCas(resp->v.v0.cas);
 }
 
 ResponseInfo::ResponseInfo(lcb_error_t err, Handle<Value> kObj) :
-        key(NULL), nkey(0), keyObj(kObj)
+        key(NULL), nkey(0), keyObj(kObj), deferDecode(false)
 {
     status = err;
     payload = Object::New();
@@ -435,7 +1203,20 @@ static void error_callback(lcb_t instance,
 
 
 
-static void get_callback(lcb_t,
+// Drop a key this connection may have changed from its near cache, and
+// let it be cached again once no other mutation of it is in flight. Failed
+// mutations are included, as a timed out one may still have been applied
+static void invalidateNearCache(lcb_t instance, const void *key, size_t nkey)
+{
+    CouchbaseImpl *me = reinterpret_cast<CouchbaseImpl *>(
+            const_cast<void *>(lcb_get_cookie(instance)));
+    NearCache &cache = me->getNearCache();
+    if (cache.isEnabled() || cache.hasPendingWrites()) {
+        cache.endWrite(key, nkey);
+    }
+}
+
+static void get_callback(lcb_t instance,
                          const void *cookie,
                          lcb_error_t error,
                          const lcb_get_resp_t *resp)
@@ -444,13 +1225,29 @@ static void get_callback(lcb_t,
         unknownLibcouchbaseType("get", resp->version);
     }
 
-    Cookie *cc = getInstance(cookie);
+    Cookie *target = getInstance(cookie)->resolve(resp->v.v0.key,
+                                                  resp->v.v0.nkey);
 
-    ResponseInfo ri(error, resp, cc);
-    cc->markProgress(ri);
+    // Before the response is handled, as the cookie may then be destroyed
+    if (error == LCB_SUCCESS && target->getNearCache()) {
+        target->getNearCache()->store(resp);
+    }
+
+    CouchbaseImpl *me = reinterpret_cast<CouchbaseImpl *>(
+            const_cast<void *>(lcb_get_cookie(instance)));
+    InflightGets &inflight = me->getInflightGets();
+    std::vector<Cookie *> waiters;
+    if (!inflight.isEmpty()) {
+        inflight.complete(target, resp->v.v0.key, resp->v.v0.nkey, waiters);
+    }
+
+    target->onGetResponse(error, resp);
+    for (unsigned int ii = 0; ii < waiters.size(); ii++) {
+        waiters[ii]->onGetResponse(error, resp);
+    }
 }
 
-static void store_callback(lcb_t,
+static void store_callback(lcb_t instance,
                            const void *cookie,
                            lcb_storage_t,
                            lcb_error_t error,
@@ -460,22 +1257,24 @@ static void store_callback(lcb_t,
         unknownLibcouchbaseType("store", resp->version);
     }
 
-    ResponseInfo ri(error, resp);
-    getInstance(cookie)->markProgress(ri);
+    invalidateNearCache(instance, resp->v.v0.key, resp->v.v0.nkey);
+    getInstance(cookie)->resolve(resp->v.v0.key, resp->v.v0.nkey)
+            ->onStoreResponse(instance, error, resp);
 }
 
-static void arithmetic_callback(lcb_t,
+static void arithmetic_callback(lcb_t instance,
                                 const void *cookie,
                                 lcb_error_t error,
                                 const lcb_arithmetic_resp_t *resp)
 {
+    invalidateNearCache(instance, resp->v.v0.key, resp->v.v0.nkey);
     ResponseInfo ri(error, resp);
     getInstance(cookie)->markProgress(ri);
 }
 
 
 
-static void remove_callback(lcb_t,
+static void remove_callback(lcb_t instance,
                             const void *cookie,
                             lcb_error_t error,
                             const lcb_remove_resp_t *resp)
@@ -484,6 +1283,7 @@ static void remove_callback(lcb_t,
         unknownLibcouchbaseType("remove", resp->version);
     }
 
+    invalidateNearCache(instance, resp->v.v0.key, resp->v.v0.nkey);
     ResponseInfo ri(error, resp);
     getInstance(cookie)->markProgress(ri);
 
@@ -528,8 +1328,7 @@ static void durability_callback(lcb_t,
                                 lcb_error_t error,
                                 const lcb_durability_resp_t *resp)
 {
-    ResponseInfo ri(error, resp);
-    getInstance(cookie)->markProgress(ri);
+    getInstance(cookie)->onDurabilityResponse(error, resp);
 }
 
 static void observe_callback(lcb_t,
@@ -554,6 +1353,18 @@ static void stats_callback(lcb_t,
     sc->update(error, resp);
 }
 
+static void http_data_callback(lcb_http_request_t,
+                               lcb_t instance,
+                               const void *cookie,
+                               lcb_error_t error,
+                               const lcb_http_resp_t *resp)
+{
+    HttpCookie *hc =
+            reinterpret_cast<HttpCookie *>(
+                    const_cast<void *>(cookie));
+    hc->onData(instance, error, resp);
+}
+
 static void http_complete_callback(lcb_http_request_t,
                                    lcb_t,
                                    const void *cookie,
@@ -578,6 +1389,7 @@ void CouchbaseImpl::setupLibcouchbaseCallbacks(void)
     lcb_set_touch_callback(instance, touch_callback);
     lcb_set_configuration_callback(instance, configuration_callback);
     lcb_set_http_complete_callback(instance, http_complete_callback);
+    lcb_set_http_data_callback(instance, http_data_callback);
     lcb_set_unlock_callback(instance, unlock_callback);
     lcb_set_durability_callback(instance, durability_callback);
     lcb_set_observe_callback(instance, observe_callback);
@@ -32,6 +32,8 @@ typedef enum {
 } CallbackMode;
 
 class Cookie;
+class CallbackBatcher;
+class NearCache;
 
 class ResponseInfo {
 public:
@@ -69,14 +71,50 @@ public:
     ResponseInfo(lcb_error_t, const lcb_durability_resp_t *);
     ResponseInfo(lcb_error_t, Handle<Value> kObj);
 
+    /**
+     * Successful results of each kind are instantiated from a template
+     * holding all of their fields in a fixed order, so that they share a
+     * single map and are created without adding properties one by one.
+     * Fields which were only set when true are always present.
+     */
+    enum Shape {
+        SHAPE_GET,
+        // A get whose value is decoded when first read
+        SHAPE_GET_LAZY,
+        SHAPE_CAS,
+        SHAPE_ARITHMETIC,
+        SHAPE_OBSERVE,
+        SHAPE_DURABILITY,
+        SHAPE_MAX
+    };
+
+    static void initialize();
+
     const void *key;
     size_t nkey;
     HandleScope scope;
     Handle<Value> keyObj;
 
+    // Reported instead of the error for status, if set
+    Handle<Value> error;
+
+    // The value is too large to be decoded in the callback, and is to be
+    // decoded with these flags instead
+    bool deferDecode;
+    uint32_t deferFlags;
+
 private:
     ResponseInfo(ResponseInfo&);
 
+    static Persistent<ObjectTemplate> shapes[SHAPE_MAX];
+
+    static Handle<Object> newPayload(Shape shape) {
+        return shapes[shape]->NewInstance();
+    }
+
+    template <typename T>
+    void initCommon(lcb_error_t, const T*, Shape);
+
     // Helpers
     void setCas(lcb_cas_t cas) {
         setField(NameMap::CAS, Cas::CreateCas(cas));
@@ -85,14 +123,20 @@ private:
     void setValue(Handle<Value>& val) {
         setField(NameMap::VALUE, val);
     }
+
+    // Defer decoding of the value until it is first read
+    void setLazyValue(const char *bytes, size_t nbytes, uint32_t flags);
 };
 
 class Cookie
 {
 public:
     Cookie(unsigned int numRemaining)
-        : hasError(false), cbType(CBMODE_SINGLE), remaining(numRemaining),
-          isCancelled(false) {}
+        : hasError(false), cbType(CBMODE_SINGLE), latency(NULL),
+          opType(OP_NONE), startTime(0), batcher(NULL),
+          sharedErrors(false), lazyValues(false), nearCache(NULL),
+          remaining(numRemaining),
+          outstanding(NULL), isCancelled(false) {}
 
     void setCallback(Handle<Function> cb, CallbackMode mode) {
         assert(callback.IsEmpty());
@@ -114,9 +158,62 @@ public:
         keyOptions = Persistent<Object>::New(options);
     }
 
+    // Record the time until each response arrives in the tracker
+    void setLatencyTracking(LatencyTracker *tracker, OpType op) {
+        latency = tracker;
+        opType = op;
+        startTime = uv_hrtime();
+    }
+
+    // Counts this cookie as in flight until it is destroyed
+    void setOutstandingCounter(unsigned int *counter) {
+        assert(outstanding == NULL);
+        outstanding = counter;
+        (*outstanding)++;
+    }
+
+    // Hand the callback invocations to the batcher instead of making
+    // them directly
+    void setCallbackBatcher(CallbackBatcher *b) {
+        batcher = b;
+    }
+
+    // Report expected failures with the errors of CBExc::sharedValue()
+    void setSharedErrors(bool val) {
+        sharedErrors = val;
+    }
+
+    // Decode JSON values only once they are read
+    void setLazyValues(bool val) {
+        lazyValues = val;
+    }
+
+    bool hasLazyValues() const { return lazyValues; }
+
+    // Store the values of successful gets in the near cache
+    void setNearCache(NearCache *cache) {
+        nearCache = cache;
+    }
+
+    NearCache *getNearCache() const { return nearCache; }
+
+    // Keep values alive until this cookie is destroyed
+    void setPinned(Handle<Value> values) {
+        assert(pinned.IsEmpty());
+        pinned = Persistent<Value>::New(values);
+    }
+
     virtual ~Cookie();
     void markProgress(ResponseInfo&);
     virtual void cancel(lcb_error_t err, Handle<Array> keys);
+    virtual void onGetResponse(lcb_error_t, const lcb_get_resp_t *);
+    virtual void onStoreResponse(lcb_t, lcb_error_t,
+                                 const lcb_store_resp_t *);
+    virtual void onDurabilityResponse(lcb_error_t,
+                                      const lcb_durability_resp_t *);
+
+    // The cookie which should receive the response for this key
+    virtual Cookie *resolve(const void *, size_t) { return this; }
 
     Handle<Value> getKeyOption(Handle<Value> key) {
         if (keyOptions.IsEmpty()) {
@@ -147,24 +244,111 @@ protected:
     CallbackMode cbType;
 
     void addSpooledInfo(Handle<Value>&, ResponseInfo&);
+    void invokeCallback(Handle<Value> err, Handle<Value> result);
     void invokeSingleCallback(Handle<Value>&, ResponseInfo&);
     void invokeSpooledCallback();
+    Handle<Value> getSpooledError();
 
     // Per-key options
     Persistent<Object> keyOptions;
 
+    void recordLatency() {
+        if (latency) {
+            latency->record(opType, uv_hrtime() - startTime);
+        }
+    }
+
+    LatencyTracker *latency;
+    OpType opType;
+    uint64_t startTime;
+    CallbackBatcher *batcher;
+    bool sharedErrors;
+    bool lazyValues;
+    NearCache *nearCache;
+
+    Handle<Value> errorValue(lcb_error_t err) {
+        if (sharedErrors) {
+            return CBExc::sharedValue(err);
+        }
+        return CBExc().eLcb(err).asValue();
+    }
 
 
 private:
     unsigned int remaining;
+    unsigned int *outstanding;
 
     Persistent<Value> parent;
+    Persistent<Value> pinned;
     bool isCancelled;
 
     // No copying
     Cookie(Cookie&);
 };
 
+/**
+ * Delivers the results of a multi-get as parallel arrays rather than an
+ * object per key. Results are stored in the order they arrive:
+ * keys[i], values[i], flags[i] and the i-th CAS all refer to the same
+ * item. Flags go into a Uint32Array and CAS values are packed into a
+ * single Buffer of 8 bytes per item, so the number of objects created no
+ * longer grows with the number of fields.
+ */
+class ColumnarCookie : public Cookie
+{
+public:
+    ColumnarCookie(unsigned int ncmds);
+    virtual ~ColumnarCookie();
+    virtual void onGetResponse(lcb_error_t, const lcb_get_resp_t *);
+    virtual void cancel(lcb_error_t, Handle<Array>);
+
+private:
+    void addResult(Handle<Value> key, lcb_error_t,
+                   const lcb_get_resp_t *);
+    void invoke();
+
+    unsigned int total;
+    unsigned int nresults;
+    Persistent<Object> result;
+    Persistent<Array> keys;
+    Persistent<Array> values;
+    Persistent<Array> errors;
+
+    // Backing stores of the flags and CAS columns
+    uint32_t *flags;
+    char *casValues;
+};
+
+/**
+ * Stores with persist_to or replicate_to. The results of successful
+ * stores are held back until every store has completed, and the keys are
+ * then polled for durability with this same cookie. Each key is reported
+ * once, with its store result and any durability error.
+ */
+class DurableCookie : public Cookie
+{
+public:
+    DurableCookie(unsigned int ncmds, const lcb_durability_opts_t &opts);
+    virtual ~DurableCookie();
+    virtual void onStoreResponse(lcb_t, lcb_error_t,
+                                 const lcb_store_resp_t *);
+    virtual void onDurabilityResponse(lcb_error_t,
+                                      const lcb_durability_resp_t *);
+
+private:
+    void poll(lcb_t instance);
+    Handle<Object> takeStored(Handle<Value> key);
+    void setDurabilityError(ResponseInfo &ri);
+
+    lcb_durability_opts_t options;
+    unsigned int nstores;
+
+    // Keys and CAS values of the successful stores
+    std::vector<std::string> storedKeys;
+    std::vector<lcb_cas_t> storedCas;
+    Persistent<Object> stored;
+};
+
 class StatsCookie : public Cookie
 {
 public:
@@ -180,11 +364,101 @@ class HttpCookie : public Cookie
 {
 public:
     HttpCookie() : Cookie(-1) {}
-    void update(lcb_error_t, const lcb_http_resp_t *);
+    virtual void update(lcb_error_t, const lcb_http_resp_t *);
+    // Body data of chunked requests
+    virtual void onData(lcb_t, lcb_error_t, const lcb_http_resp_t *) {}
     virtual void cancel(lcb_error_t err, Handle<Array>) {
         update(err, NULL);
     }
 
+protected:
+    // Invokes the callback and deletes the cookie
+    void complete(lcb_error_t, int status, const char *body, size_t nbody,
+                  const char *path, size_t npath);
+};
+
+/**
+ * Cookie for a chunked view request. Rows are split out of the response
+ * as it arrives and passed in batches to the _onRows method of a stream
+ * object; the callback receives the rest of the response once it is
+ * complete, with the rows array left empty.
+ *
+ * libcouchbase cannot stop reading a response, so a paused stream only
+ * stops delivering rows: further data is queued as raw text until the
+ * stream is resumed, and completion is held back until the queue drains.
+ *
+ * With includeDocs, the documents of each batch are fetched as soon as
+ * the batch has been received, while the rest of the view is still
+ * arriving. Batches are delivered in order once their documents are in.
+ */
+class ViewDocsCookie;
+class ViewRowCookie : public HttpCookie
+{
+public:
+    ViewRowCookie(Handle<Object> stream, bool includeDocs);
+    virtual ~ViewRowCookie();
+    virtual void update(lcb_error_t, const lcb_http_resp_t *);
+    virtual void onData(lcb_t, lcb_error_t, const lcb_http_resp_t *);
+
+    void setPaused(bool val);
+
+    // Called once all the documents of a batch have been fetched
+    void onDocsReady() { emitRows(); }
+
+    static void initialize();
+
+private:
+    static Handle<Value> FlowControl(const Arguments &);
+    Handle<Value> takeRows();
+    void deliver(Handle<Value> rows);
+    void emitRows();
+    void finish();
+
+    static Persistent<Function> flowControlFn;
+    static const size_t maxBatch = 1000;
+    // Batches whose documents may be fetched at once
+    static const size_t maxDocBatches = 4;
+
+    ViewRowParser parser;
+    std::deque<ViewDocsCookie *> docBatches;
+    Persistent<Object> stream;
+    lcb_t instance;
+    bool includeDocs;
+    bool paused;
+    bool emitting;
+    bool completed;
+    lcb_error_t finalErr;
+    int status;
+};
+
+/**
+ * Fetches the documents for one batch of view rows, and sets them as the
+ * 'doc' field of the rows referring to them, in the form the view engine
+ * uses for include_docs, or null if the document no longer exists. Each
+ * document is fetched once, however many rows refer to it; rows without
+ * an id (e.g. from a reduce) are left alone.
+ */
+class ViewDocsCookie : public Cookie
+{
+public:
+    ViewDocsCookie(ViewRowCookie *owner, Handle<Array> rows);
+    virtual ~ViewDocsCookie();
+
+    void schedule(lcb_t instance);
+    virtual void onGetResponse(lcb_error_t, const lcb_get_resp_t *);
+
+    bool isDone() const { return nremaining == 0; }
+    Handle<Array> getRows() const { return rows; }
+
+private:
+    void setDoc(const std::string &id, Handle<Value> doc);
+
+    typedef std::map<std::string, std::vector<unsigned int> > IdMap;
+
+    ViewRowCookie *owner;
+    Persistent<Array> rows;
+    IdMap ids;
+    unsigned int nremaining;
 };
 
 class ObserveCookie : public Cookie {
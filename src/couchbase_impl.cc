@@ -66,7 +66,12 @@ static Handle<Value> bailOut(const Arguments &args, CBExc &ex)
 
 CouchbaseImpl::CouchbaseImpl(lcb_t inst) :
     ObjectWrap(), connected(false), useHashtableParams(false),
-    instance(inst), lastError(LCB_SUCCESS), isShutdown(false)
+    instance(inst), lastError(LCB_SUCCESS), pendingBytes(0),
+    pendingLimit(0), pendingFailFast(false), pendingLimitHit(false),
+    sharedErrors(false), lazyValues(false), borrowBuffers(false),
+    outstanding(0), latencyTracker(NULL),
+    trackLatency(false), coalescer(this),
+    callbackBatcher(this), isShutdown(false)
 
 {
     lcb_set_cookie(instance, reinterpret_cast<void *>(this));
@@ -83,10 +88,15 @@ CouchbaseImpl::~CouchbaseImpl()
     cerr << "Destroying handle.." << endl
          << "Still have " << objectCount << " handles remaining" << endl;
 #endif
+    // While the state their callbacks may touch is still intact
+    coalescer.cancel(LCB_ERROR);
+
     if (instance) {
         lcb_destroy(instance);
     }
 
+    delete latencyTracker;
+
     EventMap::iterator iter = events.begin();
     while (iter != events.end()) {
         if (!iter->second.IsEmpty()) {
@@ -132,8 +142,12 @@ void CouchbaseImpl::Init(Handle<Object> target)
     target->Set(String::NewSymbol("CouchbaseImpl"), s_ct->GetFunction());
 
     target->Set(String::NewSymbol("Constants"), createConstants());
+    NODE_SET_METHOD(target, "registerTranscoder", Transcoder::Register);
     NameMap::initialize();
+    ResponseInfo::initialize();
+    ViewRowCookie::initialize();
     ValueFormat::initialize();
+    Cas::initialize();
 }
 
 Handle<Value> CouchbaseImpl::On(const Arguments &args)
@@ -292,6 +306,8 @@ void CouchbaseImpl::errorCallback(lcb_error_t err, const char *errinfo)
 
     if (!connected) {
         onConnect(err);
+        // Nothing queued so far will ever be scheduled
+        runScheduledOperations(err);
     }
 
     EventMap::iterator iter = events.find("error");
@@ -313,6 +329,12 @@ void CouchbaseImpl::errorCallback(lcb_error_t err, const char *errinfo)
 
 void CouchbaseImpl::onConfig(lcb_configuration_t config)
 {
+    // The callback stays installed so that cached routing information
+    // is dropped whenever the cluster topology changes
+    if (config != LCB_CONFIGURATION_UNCHANGED) {
+        routing.invalidate();
+    }
+
     if (connected) {
         return;
     }
@@ -323,7 +345,6 @@ void CouchbaseImpl::onConfig(lcb_configuration_t config)
 
     onConnect(LCB_SUCCESS);
     runScheduledOperations();
-    lcb_set_configuration_callback(instance, NULL);
 }
 
 void CouchbaseImpl::runScheduledOperations(lcb_error_t globalerr)
@@ -339,12 +360,27 @@ void CouchbaseImpl::runScheduledOperations(lcb_error_t globalerr)
         }
 
         if (err != LCB_SUCCESS) {
-            p->getCookie()->cancel(err, p->getKeyList());
+            p->cancel(err);
         }
 
+        pendingBytes -= p->getBufferBytes();
         delete p;
         pendingCommands.pop();
     }
+
+    if (!pendingLimitHit) {
+        return;
+    }
+    pendingLimitHit = false;
+
+    EventMap::iterator iter = events.find("drain");
+    if (iter == events.end() || iter->second.IsEmpty()) {
+        return;
+    }
+
+    HandleScope scope;
+    node::MakeCallback(v8::Context::GetCurrent()->Global(),
+                       iter->second, 0, NULL);
 }
 
 // static
@@ -353,6 +389,27 @@ Handle<Value> CouchbaseImpl::makeOperation(const Arguments &args, T &op)
 {
     HandleScope scope;
     CouchbaseImpl *me = ObjectWrap::Unwrap<CouchbaseImpl>(args.This());
+    op.setBufferPool(me->getBufferPool());
+    op.setBorrowBuffers(me->borrowBuffers);
+
+    if (me->nearCache.isEnabled()) {
+        op.setNearCache(&me->nearCache);
+    }
+
+    if (me->inflightGets.isEnabled()) {
+        op.setInflightGets(&me->inflightGets);
+    }
+
+    if (!me->connected && me->pendingLimit &&
+            me->pendingCommands.size() >= me->pendingLimit) {
+        me->pendingLimitHit = true;
+        if (me->pendingFailFast) {
+            CBExc ex;
+            ex.assign(ErrorCode::QUEUE_FULL,
+                      "Too many operations waiting for the connection");
+            return bailOut(args, ex);
+        }
+    }
 
     if (!op.initialize()) {
         return bailOut(args, op.getError());
@@ -362,24 +419,51 @@ Handle<Value> CouchbaseImpl::makeOperation(const Arguments &args, T &op)
         return bailOut(args, op.getError());
     }
 
+    // Held from here, as the write may be queued or coalesced for a while
+    op.beginPendingWrites();
+
     Cookie *cc = op.createCookie();
     cc->setParent(args.This());
+    cc->setOutstandingCounter(&me->outstanding);
+
+    if (me->sharedErrors) {
+        cc->setSharedErrors(true);
+    }
+
+    if (me->lazyValues) {
+        cc->setLazyValues(true);
+    }
+
+    if (me->callbackBatcher.isEnabled()) {
+        cc->setCallbackBatcher(&me->callbackBatcher);
+    }
+
+    if (me->trackLatency && op.getOpType() != OP_NONE) {
+        cc->setLatencyTracking(me->latencyTracker, op.getOpType());
+    }
 
     if (!me->connected) {
         // Schedule..
         Command *cp = op.makePersistent();
         me->pendingCommands.push(cp);
+        me->pendingBytes += cp->getBufferBytes();
         // Place into queue..
         return scope.Close(v8::True());
 
+    } else if (me->coalescer.isEnabled() && op.getBatchType() != BATCH_NONE) {
+        me->coalescer.add(op.makePersistent());
+        return scope.Close(v8::True());
+
     } else {
+        // Anything batched so far was issued before this
+        me->coalescer.flush();
         lcb_error_t err = op.execute(me->getLibcouchbaseHandle());
 
         if (err == LCB_SUCCESS) {
             return scope.Close(v8::True());
 
         } else {
-            cc->cancel(err, op.getKeyList());
+            op.cancel(err);
             return scope.Close(v8::False());
         }
     }
@@ -489,6 +573,8 @@ void CouchbaseImpl::shutdown(void)
     if (isShutdown) {
         return;
     }
+    coalescer.flush();
+
     uv_idle_t *idle = new uv_idle_t;
     memset(idle, 0, sizeof(*idle));
     uv_idle_init(uv_default_loop(), idle);
@@ -61,19 +61,32 @@ using v8::Arguments;
 #include <string>
 #include <vector>
 #include <queue>
+#include <deque>
 #include <libcouchbase/couchbase.h>
 #if LCB_VERSION < 0x020100
 #error "Couchnode requires libcouchbase >= 2.1.0"
 #endif
 
 #include "cas.h"
+#include "histogram.h"
 #include "namemap.h"
 #include "exception.h"
+#include "viewrows.h"
 #include "cookie.h"
+#include "nearcache.h"
+#include "inflight.h"
 #include "options.h"
 #include "commandlist.h"
 #include "commands.h"
+#include "transcoder.h"
 #include "valueformat.h"
+#include "jsoncodec.h"
+#include "jsonoffload.h"
+#include "snappy.h"
+#include "coalesce.h"
+#include "callbackbatch.h"
+#include "gcstats.h"
+#include "routing.h"
 
 namespace Couchnode
 {
@@ -95,7 +108,32 @@ enum ControlCode {
     CNTL_COUCHNODE_VERSION = 0x1001,
     CNTL_LIBCOUCHBASE_VERSION = 0x1002,
     CNTL_CLNODES = 0x1003,
-    CNTL_RESTURI = 0x1004
+    CNTL_RESTURI = 0x1004,
+    CNTL_BUFPOOL_STATS = 0x1005,
+    CNTL_NATIVE_JSON = 0x1006,
+    CNTL_COALESCE = 0x1007,
+    CNTL_COALESCE_MAXBATCH = 0x1008,
+    CNTL_COALESCE_MAXDELAY = 0x1009,
+    CNTL_PENDING_LIMIT = 0x100A,
+    CNTL_PENDING_FAILFAST = 0x100B,
+    CNTL_PENDING_STATS = 0x100C,
+    CNTL_LATENCY_TRACKING = 0x100D,
+    CNTL_LATENCY = 0x100E,
+    CNTL_GC_STATS = 0x100F,
+    CNTL_VBMAP_MULTI = 0x1010,
+    CNTL_OUTSTANDING = 0x1011,
+    CNTL_JSON_OFFLOAD = 0x1012,
+    CNTL_COMPRESSION = 0x1013,
+    CNTL_CALLBACK_BATCHING = 0x1014,
+    CNTL_SHARED_ERRORS = 0x1015,
+    CNTL_NEAR_CACHE_SIZE = 0x1016,
+    CNTL_NEAR_CACHE_TTL = 0x1017,
+    CNTL_NEAR_CACHE_STATS = 0x1018,
+    CNTL_GET_DEDUP = 0x1019,
+    CNTL_GET_DEDUP_JOINED = 0x101A,
+    CNTL_BORROW_BUFFERS = 0x101B,
+    CNTL_LAZY_VALUES = 0x101C,
+    CNTL_DECOMPRESSION = 0x101D
 };
 
 class CouchbaseImpl: public node::ObjectWrap
@@ -162,6 +200,117 @@ public:
         return connected;
     }
 
+    BufferPool *getBufferPool(void) {
+        return &bufPool;
+    }
+
+    Coalescer *getCoalescer(void) {
+        return &coalescer;
+    }
+
+    CallbackBatcher *getCallbackBatcher(void) {
+        return &callbackBatcher;
+    }
+
+    NearCache &getNearCache(void) {
+        return nearCache;
+    }
+
+    InflightGets &getInflightGets(void) {
+        return inflightGets;
+    }
+
+    // Returns an empty handle if no handler was set with on()
+    Handle<Function> getEventHandler(const std::string &name) {
+        EventMap::iterator iter = events.find(name);
+        if (iter == events.end()) {
+            return Handle<Function>();
+        }
+        return iter->second;
+    }
+
+    RoutingTable *getRoutingTable(void) {
+        return &routing;
+    }
+
+    // Commands issued before the connection is ready
+    size_t getPendingCount(void) const {
+        return pendingCommands.size();
+    }
+
+    size_t getPendingBytes(void) const {
+        return pendingBytes;
+    }
+
+    // Operations issued and not yet completed, pending ones included
+    unsigned int getOutstandingCount(void) const {
+        return outstanding;
+    }
+
+    // Maximum number of pending commands, or 0 for no limit. Commands
+    // issued beyond this either fail with QUEUE_FULL or, if failFast is
+    // not set, are queued anyway. Either way 'drain' is emitted once the
+    // queue has been flushed
+    void setPendingLimit(unsigned int limit) {
+        pendingLimit = limit;
+    }
+
+    unsigned int getPendingLimit(void) const {
+        return pendingLimit;
+    }
+
+    void setPendingFailFast(bool val) {
+        pendingFailFast = val;
+    }
+
+    bool getPendingFailFast(void) const {
+        return pendingFailFast;
+    }
+
+    // Whether operations issued from now on report expected failures
+    // with shared errors
+    void setSharedErrors(bool val) {
+        sharedErrors = val;
+    }
+
+    bool getSharedErrors(void) const {
+        return sharedErrors;
+    }
+
+    // Whether gets issued from now on decode JSON values on first access
+    void setLazyValues(bool val) {
+        lazyValues = val;
+    }
+
+    bool getLazyValues(void) const {
+        return lazyValues;
+    }
+
+    // Whether stores issued from now on use Buffer values in place
+    void setBorrowBuffers(bool val) {
+        borrowBuffers = val;
+    }
+
+    bool getBorrowBuffers(void) const {
+        return borrowBuffers;
+    }
+
+    // Latency histograms are only allocated once tracking is enabled
+    void setLatencyTracking(bool enabled) {
+        if (enabled && !latencyTracker) {
+            latencyTracker = new LatencyTracker;
+        }
+        trackLatency = enabled;
+    }
+
+    bool isTrackingLatency(void) const {
+        return trackLatency;
+    }
+
+    LatencyTracker *getLatencyTracker(void) {
+        return latencyTracker;
+    }
+
     static void dumpMemoryInfo(const std::string&);
 
 protected:
@@ -174,6 +323,22 @@ protected:
     EventMap events;
     Persistent<Function> connectHandler;
     std::queue<Command *> pendingCommands;
+    size_t pendingBytes;
+    unsigned int pendingLimit;
+    bool pendingFailFast;
+    bool pendingLimitHit;
+    bool sharedErrors;
+    bool lazyValues;
+    bool borrowBuffers;
+    unsigned int outstanding;
+    LatencyTracker *latencyTracker;
+    bool trackLatency;
+    BufferPool bufPool;
+    Coalescer coalescer;
+    CallbackBatcher callbackBatcher;
+    NearCache nearCache;
+    InflightGets inflightGets;
+    RoutingTable routing;
     void setupLibcouchbaseCallbacks(void);
 #ifdef COUCHNODE_DEBUG
     static unsigned int objectCount;
@@ -80,4 +80,35 @@ Handle<Value> CBExc::asValue()
     return e;
 }
 
+Handle<Value> CBExc::sharedValue(lcb_error_t err)
+{
+    static Persistent<Value> missing;
+    static Persistent<Value> exists;
+
+    Persistent<Value> *slot;
+    switch (err) {
+    case LCB_KEY_ENOENT:
+        slot = &missing;
+        break;
+    case LCB_KEY_EEXISTS:
+        slot = &exists;
+        break;
+    default:
+        return CBExc().eLcb(err).asValue();
+    }
+
+    if (slot->IsEmpty()) {
+        HandleScope scope;
+        Handle<Object> objectFn = v8::Context::GetCurrent()->Global()->Get(
+                String::NewSymbol("Object")).As<Object>();
+        Handle<Function> freeze = objectFn->Get(
+                String::NewSymbol("freeze")).As<Function>();
+
+        Handle<Value> e = CBExc().eLcb(err).asValue();
+        freeze->Call(objectFn, 1, &e);
+        *slot = Persistent<Value>::New(e);
+    }
+    return *slot;
+}
+
 }
@@ -40,7 +40,8 @@ public:
         SCHEDULING,
         CHECK_RESULTS,
         GENERIC,
-        DURABILITY_FAILED
+        DURABILITY_FAILED,
+        QUEUE_FULL
     };
 };
 
@@ -108,6 +109,15 @@ public:
 
     Handle<Value> asValue();
 
+    /**
+     * Returns a single, frozen Error shared by all the keys failing with
+     * a status which is an expected outcome rather than a failure (a
+     * missing key on get, an existing one on add). Its stack is that of
+     * its creation, and it cannot be modified. Any other status gets a
+     * new Error
+     */
+    static Handle<Value> sharedValue(lcb_error_t err);
+
 
     Handle<Value> throwV8Object() {
         return v8::ThrowException(asValue());
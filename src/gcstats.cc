@@ -0,0 +1,78 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase_impl.h"
+
+namespace Couchnode
+{
+
+bool GcStats::installed = false;
+uint64_t GcStats::count = 0;
+uint64_t GcStats::pauseTime = 0;
+uint64_t GcStats::allocated = 0;
+uint64_t GcStats::gcStart = 0;
+size_t GcStats::lastHeapUsed = 0;
+
+size_t GcStats::getHeapUsed()
+{
+    v8::HeapStatistics stats;
+    v8::V8::GetHeapStatistics(&stats);
+    return stats.used_heap_size();
+}
+
+void GcStats::onPrologue(v8::GCType, v8::GCCallbackFlags)
+{
+    size_t used = getHeapUsed();
+    if (used > lastHeapUsed) {
+        allocated += used - lastHeapUsed;
+    }
+    gcStart = uv_hrtime();
+}
+
+void GcStats::onEpilogue(v8::GCType, v8::GCCallbackFlags)
+{
+    pauseTime += uv_hrtime() - gcStart;
+    count++;
+    lastHeapUsed = getHeapUsed();
+}
+
+void GcStats::reset()
+{
+    if (!installed) {
+        v8::V8::AddGCPrologueCallback(onPrologue);
+        v8::V8::AddGCEpilogueCallback(onEpilogue);
+        installed = true;
+    }
+
+    count = pauseTime = allocated = 0;
+    lastHeapUsed = getHeapUsed();
+}
+
+void GcStats::getSnapshot(Snapshot *out)
+{
+    size_t used = getHeapUsed();
+
+    out->count = count;
+    out->pauseTime = pauseTime;
+    out->allocated = allocated;
+    if (installed && used > lastHeapUsed) {
+        out->allocated += used - lastHeapUsed;
+    }
+    out->heapUsed = used;
+}
+
+}
@@ -0,0 +1,64 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef COUCHNODE_GCSTATS_H
+#define COUCHNODE_GCSTATS_H 1
+#ifndef COUCHBASE_H
+#error "include couchbase_impl.h first"
+#endif
+
+namespace Couchnode
+{
+
+/**
+ * Process-wide garbage collector counters, collected from V8's GC
+ * prologue and epilogue callbacks. Used by the benchmark suite to report
+ * GC time and allocation volume without any JavaScript-side sampling.
+ */
+class GcStats
+{
+public:
+    struct Snapshot {
+        // Number of collections
+        uint64_t count;
+        // Total time spent in collections, in nanoseconds
+        uint64_t pauseTime;
+        // Bytes allocated on the V8 heap since the counters were reset.
+        // Estimated from heap usage before and after each collection
+        uint64_t allocated;
+        size_t heapUsed;
+    };
+
+    // Installs the callbacks (once) and zeroes the counters
+    static void reset();
+    static void getSnapshot(Snapshot *out);
+
+private:
+    static void onPrologue(v8::GCType, v8::GCCallbackFlags);
+    static void onEpilogue(v8::GCType, v8::GCCallbackFlags);
+    static size_t getHeapUsed();
+
+    static bool installed;
+    static uint64_t count;
+    static uint64_t pauseTime;
+    static uint64_t allocated;
+    static uint64_t gcStart;
+    static size_t lastHeapUsed;
+};
+
+}
+
+#endif
@@ -0,0 +1,114 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase_impl.h"
+
+namespace Couchnode
+{
+
+unsigned int LatencyHistogram::bucketFor(uint64_t ns)
+{
+    if (ns < SUB_COUNT) {
+        return (unsigned int)ns;
+    }
+
+    int msb = 0;
+    for (uint64_t tmp = ns; tmp > 1; tmp >>= 1) {
+        msb++;
+    }
+
+    if (msb >= MAX_BITS) {
+        return NBUCKETS - 1;
+    }
+
+    // (ns >> shift) is in [SUB_COUNT, 2 * SUB_COUNT)
+    int shift = msb - SUB_BITS;
+    return (shift + 1) * SUB_COUNT + (unsigned int)(ns >> shift) - SUB_COUNT;
+}
+
+uint64_t LatencyHistogram::bucketHighest(unsigned int ix)
+{
+    if (ix < SUB_COUNT) {
+        return ix;
+    }
+
+    int shift = ix / SUB_COUNT - 1;
+    uint64_t sub = ix % SUB_COUNT + SUB_COUNT;
+    return ((sub + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::getPercentile(double fraction) const
+{
+    if (!count) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(fraction * count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (unsigned int ii = 0; ii < NBUCKETS; ii++) {
+        seen += counts[ii];
+        if (seen >= rank) {
+            uint64_t ret = bucketHighest(ii);
+            // The last bucket also holds all clamped values
+            if (ret > max || ii == NBUCKETS - 1) {
+                return max;
+            } else if (ret < min) {
+                return min;
+            }
+            return ret;
+        }
+    }
+    return max;
+}
+
+const char *LatencyTracker::getOpName(OpType op)
+{
+    switch (op) {
+    case OP_GET:
+        return "get";
+    case OP_LOCK:
+        return "lock";
+    case OP_SET:
+        return "set";
+    case OP_ADD:
+        return "add";
+    case OP_REPLACE:
+        return "replace";
+    case OP_APPEND:
+        return "append";
+    case OP_PREPEND:
+        return "prepend";
+    case OP_REMOVE:
+        return "remove";
+    case OP_ARITHMETIC:
+        return "arithmetic";
+    case OP_TOUCH:
+        return "touch";
+    case OP_UNLOCK:
+        return "unlock";
+    case OP_ENDURE:
+        return "endure";
+    default:
+        return "unknown";
+    }
+}
+
+}
@@ -0,0 +1,130 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef COUCHNODE_HISTOGRAM_H
+#define COUCHNODE_HISTOGRAM_H
+#include <cstring>
+#include <stdint.h>
+namespace Couchnode
+{
+
+/**
+ * Operation types for which latencies are tracked
+ */
+enum OpType {
+    OP_NONE = -1,
+    OP_GET = 0,
+    OP_LOCK,
+    OP_SET,
+    OP_ADD,
+    OP_REPLACE,
+    OP_APPEND,
+    OP_PREPEND,
+    OP_REMOVE,
+    OP_ARITHMETIC,
+    OP_TOUCH,
+    OP_UNLOCK,
+    OP_ENDURE,
+    OP_MAX
+};
+
+/**
+ * Log-linear histogram of durations in nanoseconds, in the style of
+ * HdrHistogram. Values below 2^SUB_BITS each get their own bucket; above
+ * that, every power of two is split into 2^SUB_BITS linear buckets, so
+ * the relative error of any recorded value is below 1/2^SUB_BITS (~3%).
+ * Values beyond 2^MAX_BITS ns (about 68 seconds) are clamped.
+ */
+class LatencyHistogram
+{
+public:
+    enum {
+        SUB_BITS = 5,
+        SUB_COUNT = 1 << SUB_BITS,
+        MAX_BITS = 36,
+        NBUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT
+    };
+
+    LatencyHistogram() { reset(); }
+
+    void record(uint64_t ns) {
+        counts[bucketFor(ns)]++;
+        if (!count || ns < min) {
+            min = ns;
+        }
+        if (ns > max) {
+            max = ns;
+        }
+        total += ns;
+        count++;
+    }
+
+    void reset() {
+        memset(counts, 0, sizeof(counts));
+        count = total = min = max = 0;
+    }
+
+    uint64_t getCount() const { return count; }
+    uint64_t getMin() const { return min; }
+    uint64_t getMax() const { return max; }
+    double getMean() const { return count ? (double)total / count : 0; }
+
+    /**
+     * Get the value below which the given fraction of recorded values
+     * fall. The result is the highest value of the matching bucket
+     */
+    uint64_t getPercentile(double fraction) const;
+
+private:
+    static unsigned int bucketFor(uint64_t ns);
+    static uint64_t bucketHighest(unsigned int ix);
+
+    uint64_t counts[NBUCKETS];
+    uint64_t count;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+};
+
+/**
+ * The latency histograms of a connection, one per operation type
+ */
+class LatencyTracker
+{
+public:
+    void record(OpType op, uint64_t ns) {
+        histograms[op].record(ns);
+    }
+
+    void reset() {
+        for (int ii = 0; ii < OP_MAX; ii++) {
+            histograms[ii].reset();
+        }
+    }
+
+    const LatencyHistogram &get(OpType op) const {
+        return histograms[op];
+    }
+
+    static const char *getOpName(OpType op);
+
+private:
+    LatencyHistogram histograms[OP_MAX];
+};
+
+}
+#endif
@@ -0,0 +1,92 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "couchbase_impl.h"
+
+namespace Couchnode
+{
+
+bool InflightGets::join(const char *key, size_t nkey, Cookie *cookie)
+{
+    std::string k(key, nkey);
+    EntryMap::iterator iter = entries.find(k);
+
+    if (iter == entries.end()) {
+        entries[k].owner = cookie;
+        return false;
+    }
+
+    if (iter->second.closed) {
+        return false;
+    }
+
+    iter->second.waiters.push_back(cookie);
+    joined++;
+    return true;
+}
+
+void InflightGets::complete(Cookie *cookie, const void *key, size_t nkey,
+                            std::vector<Cookie *> &waiters)
+{
+    EntryMap::iterator iter =
+            entries.find(std::string((const char *)key, nkey));
+
+    // A get of this key which did not take part, e.g. a locking one
+    if (iter == entries.end() || iter->second.owner != cookie) {
+        return;
+    }
+
+    waiters.swap(iter->second.waiters);
+    entries.erase(iter);
+}
+
+void InflightGets::invalidate(const char *key, size_t nkey)
+{
+    EntryMap::iterator iter = entries.find(std::string(key, nkey));
+    if (iter != entries.end()) {
+        iter->second.closed = true;
+    }
+}
+
+void InflightGets::abandon(Cookie *cookie, lcb_error_t err)
+{
+    std::vector<std::pair<std::string, Cookie *> > failed;
+
+    EntryMap::iterator iter = entries.begin();
+    while (iter != entries.end()) {
+        if (iter->second.owner != cookie) {
+            ++iter;
+            continue;
+        }
+
+        std::vector<Cookie *> &waiters = iter->second.waiters;
+        for (unsigned int ii = 0; ii < waiters.size(); ii++) {
+            failed.push_back(std::make_pair(iter->first, waiters[ii]));
+        }
+        entries.erase(iter++);
+    }
+
+    // The entries are gone first, as the callbacks may issue new gets
+    HandleScope scope;
+    for (unsigned int ii = 0; ii < failed.size(); ii++) {
+        const std::string &key = failed[ii].first;
+        Handle<Array> keys = Array::New(1);
+        keys->Set(0, String::New(key.data(), key.size()));
+        failed[ii].second->cancel(err, keys);
+    }
+}
+
+}
@@ -0,0 +1,93 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef COUCHNODE_INFLIGHT_H
+#define COUCHNODE_INFLIGHT_H 1
+#ifndef COUCHBASE_H
+#error "include couchbase_impl.h first"
+#endif
+
+#include <string>
+
+namespace Couchnode
+{
+
+/**
+ * The keys a connection is currently fetching with plain gets, so that a
+ * get for a key already being fetched waits for that response instead of
+ * sending its own. The cookie whose command fetches a key owns its
+ * entry; the response to the owner is handed to every cookie which
+ * joined it, and a failure to schedule the owner's command fails them
+ * too.
+ */
+class InflightGets
+{
+public:
+    InflightGets() : enabled(false), joined(0) {}
+
+    // Only commands issued while enabled join or create entries
+    bool isEnabled() const { return enabled; }
+    void setEnabled(bool val) { enabled = val; }
+
+    /**
+     * Registers a fetch of the key for the cookie.
+     * @return true if the key is already being fetched, and was not
+     *  mutated since, in which case the cookie will be given that
+     *  response and must not fetch it
+     */
+    bool join(const char *key, size_t nkey, Cookie *cookie);
+
+    /**
+     * Called with each get response, before it is given to the cookie.
+     * If the cookie owns the fetch of the key, the entry is dropped and
+     * the cookies waiting for it are moved to waiters
+     */
+    void complete(Cookie *cookie, const void *key, size_t nkey,
+                  std::vector<Cookie *> &waiters);
+
+    // Fails the cookies waiting for the keys the cookie owns
+    void abandon(Cookie *cookie, lcb_error_t err);
+
+    /**
+     * A mutation of the key was issued. The fetch in flight may be
+     * answered from before it, so gets issued from now on fetch the key
+     * themselves; those which already joined still share its response
+     */
+    void invalidate(const char *key, size_t nkey);
+
+    bool isEmpty() const { return entries.empty(); }
+
+    // Number of gets which waited for another one's response
+    uint64_t getJoinedCount() const { return joined; }
+
+private:
+    struct Entry {
+        Entry() : owner(NULL), closed(false) {}
+        Cookie *owner;
+        std::vector<Cookie *> waiters;
+        // Set by invalidate(); no longer joined
+        bool closed;
+    };
+
+    typedef std::map<std::string, Entry> EntryMap;
+    EntryMap entries;
+    bool enabled;
+    uint64_t joined;
+};
+
+}
+
+#endif
@@ -0,0 +1,802 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase_impl.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COUCHNODE_JSON_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace Couchnode
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/// Scanning                                                                 ///
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef COUCHNODE_JSON_SSE2
+static inline unsigned int firstBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long ix;
+    _BitScanForward(&ix, mask);
+    return ix;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+/**
+ * Returns the first character in [p, end) which terminates a run of plain
+ * string content: a quote, a backslash or a control character. Returns
+ * end if there is none.
+ */
+static inline const char *scanString(const char *p, const char *end)
+{
+#ifdef COUCHNODE_JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i ctl = _mm_set1_epi8(0x1f);
+
+    while (end - p >= 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(x, quote),
+                                 _mm_cmpeq_epi8(x, bslash));
+        // x <= 0x1f (unsigned)
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_max_epu8(x, ctl), ctl));
+
+        unsigned int mask = _mm_movemask_epi8(m);
+        if (mask) {
+            return p + firstBit(mask);
+        }
+        p += 16;
+    }
+#endif
+
+    for (; p < end; p++) {
+        unsigned char c = *p;
+        if (c == '"' || c == '\\' || c < 0x20) {
+            return p;
+        }
+    }
+    return end;
+}
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static void appendUtf8(std::string &out, unsigned int cp)
+{
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xc0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        out += (char)(0xe0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    } else {
+        out += (char)(0xf0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3f));
+        out += (char)(0x80 | ((cp >> 6) & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/// Parsing                                                                  ///
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+void JsonTape::clear()
+{
+    nodes.clear();
+    strings.clear();
+    base = cur = end = NULL;
+}
+
+JsonTape::Status JsonTape::parse(const char *bytes, size_t n)
+{
+    clear();
+    base = cur = bytes;
+    end = bytes + n;
+    status = PARSE_OK;
+
+    skipSpace();
+    if (!parseValue(0)) {
+        return status;
+    }
+
+    skipSpace();
+    if (cur != end) {
+        return PARSE_INVALID;
+    }
+    return PARSE_OK;
+}
+
+void JsonTape::skipSpace()
+{
+    while (cur < end &&
+            (*cur == ' ' || *cur == '\n' || *cur == '\r' || *cur == '\t')) {
+        cur++;
+    }
+}
+
+bool JsonTape::parseValue(int depth)
+{
+    if (cur == end) {
+        return fail(PARSE_INVALID);
+    }
+
+    switch (*cur) {
+    case '{':
+        return parseContainer(depth + 1, true);
+    case '[':
+        return parseContainer(depth + 1, false);
+    case '"':
+        return parseString();
+    case 't':
+        return parseLiteral("true", 4, T_TRUE);
+    case 'f':
+        return parseLiteral("false", 5, T_FALSE);
+    case 'n':
+        return parseLiteral("null", 4, T_NULL);
+    default:
+        if (*cur == '-' || isDigit(*cur)) {
+            return parseNumber();
+        }
+        return fail(PARSE_INVALID);
+    }
+}
+
+bool JsonTape::parseLiteral(const char *lit, size_t n, NodeType type)
+{
+    if ((size_t)(end - cur) < n || memcmp(cur, lit, n) != 0) {
+        return fail(PARSE_INVALID);
+    }
+    cur += n;
+    pushNode(type, 0);
+    return true;
+}
+
+bool JsonTape::parseContainer(int depth, bool isObject)
+{
+    if (depth > maxDepth) {
+        return fail(PARSE_UNSUPPORTED);
+    }
+
+    char terminator = isObject ? '}' : ']';
+    size_t ix = nodes.size();
+    size_t count = 0;
+    pushNode(isObject ? T_OBJECT : T_ARRAY, 0);
+
+    cur++;
+    skipSpace();
+    if (cur < end && *cur == terminator) {
+        cur++;
+        return true;
+    }
+
+    for (;;) {
+        skipSpace();
+        if (isObject) {
+            if (cur == end || *cur != '"') {
+                return fail(PARSE_INVALID);
+            }
+            if (!parseString()) {
+                return false;
+            }
+            skipSpace();
+            if (cur == end || *cur != ':') {
+                return fail(PARSE_INVALID);
+            }
+            cur++;
+            skipSpace();
+        }
+
+        if (!parseValue(depth)) {
+            return false;
+        }
+        count++;
+
+        skipSpace();
+        if (cur == end) {
+            return fail(PARSE_INVALID);
+        } else if (*cur == ',') {
+            cur++;
+        } else if (*cur == terminator) {
+            cur++;
+            break;
+        } else {
+            return fail(PARSE_INVALID);
+        }
+    }
+
+    nodes[ix].size = count;
+    return true;
+}
+
+bool JsonTape::parseString()
+{
+    const char *start = ++cur;
+    const char *stop = scanString(cur, end);
+
+    if (stop == end) {
+        return fail(PARSE_INVALID);
+    }
+
+    if (*stop == '"') {
+        pushNode(T_STRING, stop - start);
+        nodes.back().u.offset = start - base;
+        cur = stop + 1;
+        return true;
+    }
+
+    if (*stop != '\\') {
+        // Unescaped control character
+        return fail(PARSE_INVALID);
+    }
+
+    cur = stop;
+    return unescape(start);
+}
+
+bool JsonTape::unescape(const char *start)
+{
+    size_t offset = strings.size();
+    strings.append(start, cur - start);
+
+    for (;;) {
+        if (cur == end) {
+            return fail(PARSE_INVALID);
+        }
+
+        if (*cur == '"') {
+            cur++;
+            break;
+        }
+
+        if (*cur != '\\') {
+            const char *stop = scanString(cur, end);
+            if (stop == end || (*stop != '"' && *stop != '\\')) {
+                return fail(PARSE_INVALID);
+            }
+            strings.append(cur, stop - cur);
+            cur = stop;
+            continue;
+        }
+
+        if (end - cur < 2) {
+            return fail(PARSE_INVALID);
+        }
+
+        char esc = cur[1];
+        cur += 2;
+
+        switch (esc) {
+        case '"':
+        case '\\':
+        case '/':
+            strings += esc;
+            break;
+        case 'b':
+            strings += '\b';
+            break;
+        case 'f':
+            strings += '\f';
+            break;
+        case 'n':
+            strings += '\n';
+            break;
+        case 'r':
+            strings += '\r';
+            break;
+        case 't':
+            strings += '\t';
+            break;
+        case 'u': {
+            unsigned int cp = 0;
+            if (end - cur < 4) {
+                return fail(PARSE_INVALID);
+            }
+            for (int ii = 0; ii < 4; ii++) {
+                int hv = hexValue(cur[ii]);
+                if (hv < 0) {
+                    return fail(PARSE_INVALID);
+                }
+                cp = (cp << 4) | hv;
+            }
+            cur += 4;
+
+            if (cp >= 0xd800 && cp <= 0xdbff) {
+                unsigned int lo = 0;
+                if (end - cur < 6 || cur[0] != '\\' || cur[1] != 'u') {
+                    return fail(PARSE_UNSUPPORTED);
+                }
+                for (int ii = 2; ii < 6; ii++) {
+                    int hv = hexValue(cur[ii]);
+                    if (hv < 0) {
+                        return fail(PARSE_INVALID);
+                    }
+                    lo = (lo << 4) | hv;
+                }
+                if (lo < 0xdc00 || lo > 0xdfff) {
+                    return fail(PARSE_UNSUPPORTED);
+                }
+                cur += 6;
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+
+            } else if (cp >= 0xdc00 && cp <= 0xdfff) {
+                return fail(PARSE_UNSUPPORTED);
+            }
+
+            appendUtf8(strings, cp);
+            break;
+        }
+        default:
+            return fail(PARSE_INVALID);
+        }
+    }
+
+    pushNode(T_STRING_ESC, strings.size() - offset);
+    nodes.back().u.offset = offset;
+    return true;
+}
+
+bool JsonTape::parseNumber()
+{
+    const char *start = cur;
+    bool isInteger = true;
+
+    if (*cur == '-') {
+        cur++;
+    }
+
+    if (cur == end || !isDigit(*cur)) {
+        return fail(PARSE_INVALID);
+    }
+
+    if (*cur == '0') {
+        cur++;
+    } else {
+        while (cur < end && isDigit(*cur)) {
+            cur++;
+        }
+    }
+
+    if (cur < end && *cur == '.') {
+        isInteger = false;
+        cur++;
+        if (cur == end || !isDigit(*cur)) {
+            return fail(PARSE_INVALID);
+        }
+        while (cur < end && isDigit(*cur)) {
+            cur++;
+        }
+    }
+
+    if (cur < end && (*cur == 'e' || *cur == 'E')) {
+        isInteger = false;
+        cur++;
+        if (cur < end && (*cur == '+' || *cur == '-')) {
+            cur++;
+        }
+        if (cur == end || !isDigit(*cur)) {
+            return fail(PARSE_INVALID);
+        }
+        while (cur < end && isDigit(*cur)) {
+            cur++;
+        }
+    }
+
+    double num;
+    size_t len = cur - start;
+
+    // Up to 15 digits are always exactly representable
+    if (isInteger && len <= 15) {
+        const char *p = start;
+        bool negative = *p == '-';
+        int64_t acc = 0;
+
+        if (negative) {
+            p++;
+        }
+        for (; p < cur; p++) {
+            acc = acc * 10 + (*p - '0');
+        }
+        num = (double)(negative ? -acc : acc);
+
+    } else {
+        // strtod needs a terminated string
+        char sbuf[64];
+        std::string lbuf;
+        const char *s;
+
+        if (len < sizeof(sbuf)) {
+            memcpy(sbuf, start, len);
+            sbuf[len] = '\0';
+            s = sbuf;
+        } else {
+            lbuf.assign(start, len);
+            s = lbuf.c_str();
+        }
+        num = strtod(s, NULL);
+    }
+
+    pushNode(T_NUMBER, 0);
+    nodes.back().u.num = num;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/// Materialization                                                          ///
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+Handle<Value> JsonTape::materialize() const
+{
+    size_t ix = 0;
+    if (nodes.empty()) {
+        return Handle<Value>();
+    }
+    return materializeAt(ix);
+}
+
+Handle<Value> JsonTape::materializeAt(size_t &ix) const
+{
+    const Node &node = nodes[ix++];
+
+    switch (node.type) {
+    case T_NULL:
+        return v8::Null();
+
+    case T_TRUE:
+        return v8::True();
+
+    case T_FALSE:
+        return v8::False();
+
+    case T_NUMBER:
+        return Number::New(node.u.num);
+
+    case T_STRING:
+    case T_STRING_ESC:
+        return String::New(stringAt(node), node.size);
+
+    case T_ARRAY: {
+        Handle<v8::Array> arr = v8::Array::New(node.size);
+        for (unsigned int ii = 0; ii < node.size; ii++) {
+            arr->Set(ii, materializeAt(ix));
+        }
+        return arr;
+    }
+
+    case T_OBJECT: {
+        Handle<Object> obj = Object::New();
+        for (unsigned int ii = 0; ii < node.size; ii++) {
+            const Node &knode = nodes[ix++];
+            const char *kstr = stringAt(knode);
+            Handle<String> key = String::NewSymbol(kstr, knode.size);
+            Handle<Value> value = materializeAt(ix);
+
+            // JSON.parse creates an own property named __proto__ rather
+            // than setting the prototype
+            if (knode.size == 9 && memcmp(kstr, "__proto__", 9) == 0) {
+                obj->ForceSet(key, value);
+            } else {
+                obj->Set(key, value);
+            }
+        }
+        return obj;
+    }
+
+    default:
+        abort();
+        return Handle<Value>();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/// Encoding                                                                 ///
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+JsonEncoder::Status JsonEncoder::encode(Handle<Value> input, std::string &out)
+{
+    out.clear();
+    Status status = writeValue(input, String::Empty(), out, 0);
+
+    // Top-level undefined and functions; let JSON.stringify decide
+    if (status == ENCODE_SKIP) {
+        return ENCODE_FALLBACK;
+    }
+    return status;
+}
+
+JsonEncoder::Status JsonEncoder::writeValue(Handle<Value> v,
+                                            Handle<Value> holderKey,
+                                            std::string &out,
+                                            int depth)
+{
+    if (v.IsEmpty()) {
+        return ENCODE_ERROR;
+    }
+
+    if (v->IsString()) {
+        writeString(v.As<String>(), out);
+        return ENCODE_OK;
+
+    } else if (v->IsNumber()) {
+        writeNumber(v->NumberValue(), out);
+        return ENCODE_OK;
+
+    } else if (v->IsTrue()) {
+        out.append("true", 4);
+        return ENCODE_OK;
+
+    } else if (v->IsFalse()) {
+        out.append("false", 5);
+        return ENCODE_OK;
+
+    } else if (v->IsNull()) {
+        out.append("null", 4);
+        return ENCODE_OK;
+
+    } else if (v->IsUndefined() || v->IsFunction()) {
+        return ENCODE_SKIP;
+
+    } else if (!v->IsObject()) {
+        return ENCODE_FALLBACK;
+    }
+
+    // Beyond this, the value is most likely cyclic. JSON.stringify will
+    // throw the proper error for it
+    if (++depth > maxDepth) {
+        return ENCODE_FALLBACK;
+    }
+
+    Handle<Object> obj = v.As<Object>();
+    if (obj->IsStringObject() || obj->IsNumberObject() ||
+            obj->IsBooleanObject()) {
+        return ENCODE_FALLBACK;
+    }
+
+    Handle<Value> toJSON = obj->Get(NameMap::names[NameMap::TO_JSON]);
+    if (toJSON.IsEmpty()) {
+        return ENCODE_ERROR;
+    }
+
+    if (toJSON->IsFunction()) {
+        Handle<Value> key = holderKey->ToString();
+        return writeValue(toJSON.As<Function>()->Call(obj, 1, &key),
+                          holderKey, out, depth);
+    }
+
+    if (obj->IsArray()) {
+        Handle<v8::Array> arr = obj.As<v8::Array>();
+        unsigned int len = arr->Length();
+
+        out += '[';
+        for (unsigned int ii = 0; ii < len; ii++) {
+            if (ii) {
+                out += ',';
+            }
+
+            Status status = writeValue(arr->Get(ii), v8::Integer::New(ii),
+                                       out, depth);
+            if (status == ENCODE_SKIP) {
+                out.append("null", 4);
+            } else if (status != ENCODE_OK) {
+                return status;
+            }
+        }
+        out += ']';
+        return ENCODE_OK;
+    }
+
+    Handle<v8::Array> names = obj->GetOwnPropertyNames();
+    unsigned int len = names->Length();
+    bool first = true;
+
+    out += '{';
+    for (unsigned int ii = 0; ii < len; ii++) {
+        Handle<String> name = names->Get(ii)->ToString();
+        size_t mark = out.size();
+
+        if (!first) {
+            out += ',';
+        }
+        writeString(name, out);
+        out += ':';
+
+        Status status = writeValue(obj->Get(name), name, out, depth);
+        if (status == ENCODE_SKIP) {
+            out.resize(mark);
+            continue;
+        } else if (status != ENCODE_OK) {
+            return status;
+        }
+        first = false;
+    }
+    out += '}';
+    return ENCODE_OK;
+}
+
+void JsonEncoder::writeString(Handle<String> s, std::string &out)
+{
+    static std::string raw;
+    static const char hexDigits[] = "0123456789abcdef";
+
+    // Reserve the worst case rather than measuring the string first
+    raw.resize((size_t)s->Length() * 3);
+    if (!raw.empty()) {
+        raw.resize(s->WriteUtf8(&raw[0], raw.size(), NULL,
+                                String::NO_NULL_TERMINATION));
+    }
+
+    const char *p = raw.data();
+    const char *end = p + raw.size();
+
+    out += '"';
+    while (p < end) {
+        const char *stop = scanString(p, end);
+        out.append(p, stop - p);
+        if (stop == end) {
+            break;
+        }
+
+        unsigned char c = *stop;
+        out += '\\';
+        switch (c) {
+        case '"':
+        case '\\':
+            out += c;
+            break;
+        case '\b':
+            out += 'b';
+            break;
+        case '\f':
+            out += 'f';
+            break;
+        case '\n':
+            out += 'n';
+            break;
+        case '\r':
+            out += 'r';
+            break;
+        case '\t':
+            out += 't';
+            break;
+        default:
+            out.append("u00", 3);
+            out += hexDigits[c >> 4];
+            out += hexDigits[c & 0xf];
+            break;
+        }
+        p = stop + 1;
+    }
+    out += '"';
+}
+
+/**
+ * Formats a number the way Number.prototype.toString does: the shortest
+ * digit string which reads back as the same double, laid out per
+ * ECMA-262 9.8.1
+ */
+void JsonEncoder::writeNumber(double d, std::string &out)
+{
+    if (d != d || std::fabs(d) == std::numeric_limits<double>::infinity()) {
+        out.append("null", 4);
+        return;
+    }
+
+    if (d == 0) {
+        out += '0';
+        return;
+    }
+
+    char buf[64];
+    if (d == std::floor(d) && std::fabs(d) < 1e15) {
+        int nw = snprintf(buf, sizeof(buf), "%.0f", d);
+        out.append(buf, nw);
+        return;
+    }
+
+    for (int prec = 1; prec <= 17; prec++) {
+        snprintf(buf, sizeof(buf), "%.*e", prec - 1, d);
+        if (strtod(buf, NULL) == d) {
+            break;
+        }
+    }
+
+    // buf is now [-]d[.ddd]e[+-]xx
+    const char *p = buf;
+    char digits[32];
+    int k = 0;
+
+    if (*p == '-') {
+        out += '-';
+        p++;
+    }
+    for (; *p != 'e'; p++) {
+        if (*p != '.') {
+            digits[k++] = *p;
+        }
+    }
+    while (k > 1 && digits[k - 1] == '0') {
+        k--;
+    }
+    int n = atoi(p + 1) + 1;
+
+    if (k <= n && n <= 21) {
+        out.append(digits, k);
+        out.append(n - k, '0');
+
+    } else if (0 < n && n <= 21) {
+        out.append(digits, n);
+        out += '.';
+        out.append(digits + n, k - n);
+
+    } else if (-6 < n && n <= 0) {
+        out.append("0.", 2);
+        out.append(-n, '0');
+        out.append(digits, k);
+
+    } else {
+        out += digits[0];
+        if (k > 1) {
+            out += '.';
+            out.append(digits + 1, k - 1);
+        }
+        int nw = snprintf(buf, sizeof(buf), "e%c%d",
+                          n - 1 < 0 ? '-' : '+', std::abs(n - 1));
+        out.append(buf, nw);
+    }
+}
+
+}
@@ -0,0 +1,147 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef COUCHNODE_JSONCODEC_H
+#define COUCHNODE_JSONCODEC_H 1
+#ifndef COUCHBASE_H
+#error "include couchbase_impl.h first"
+#endif
+
+#include <string>
+#include <vector>
+
+namespace Couchnode
+{
+
+/**
+ * A parsed JSON document in a flat, pre-order form.
+ *
+ * Parsing does not touch V8 at all, so it may happen on any thread; the
+ * V8 values are only built when materialize() is called. String nodes
+ * without escapes point straight into the input, so the input must
+ * remain valid until the tape is materialized.
+ */
+class JsonTape
+{
+public:
+    enum Status {
+        PARSE_OK,
+        // The input is not valid JSON
+        PARSE_INVALID,
+        // The input is valid but cannot be represented faithfully by the
+        // tape (e.g. lone surrogates, or nesting too deep). Use JSON.parse
+        PARSE_UNSUPPORTED
+    };
+
+    JsonTape() : base(NULL), cur(NULL), end(NULL) {}
+
+    Status parse(const char *bytes, size_t n);
+    Handle<Value> materialize() const;
+    void clear();
+
+private:
+    enum NodeType {
+        T_NULL,
+        T_TRUE,
+        T_FALSE,
+        T_NUMBER,
+        // Raw string, offset relative to the input
+        T_STRING,
+        // Unescaped string, offset relative to 'strings'
+        T_STRING_ESC,
+        T_ARRAY,
+        T_OBJECT
+    };
+
+    struct Node {
+        unsigned char type;
+        // String length, or number of elements (pairs for objects)
+        size_t size;
+        union {
+            double num;
+            size_t offset;
+        } u;
+    };
+
+    static const int maxDepth = 256;
+
+    bool parseValue(int depth);
+    bool parseContainer(int depth, bool isObject);
+    bool parseString();
+    bool parseNumber();
+    bool parseLiteral(const char *lit, size_t n, NodeType type);
+    bool unescape(const char *start);
+    void skipSpace();
+    bool fail(Status s) {
+        status = s;
+        return false;
+    }
+
+    void pushNode(NodeType type, size_t size) {
+        Node node;
+        node.type = type;
+        node.size = size;
+        node.u.offset = 0;
+        nodes.push_back(node);
+    }
+
+    const char *stringAt(const Node &node) const {
+        if (node.type == T_STRING) {
+            return base + node.u.offset;
+        }
+        return strings.data() + node.u.offset;
+    }
+
+    Handle<Value> materializeAt(size_t &ix) const;
+
+    std::vector<Node> nodes;
+    std::string strings;
+    const char *base;
+    const char *cur;
+    const char *end;
+    Status status;
+};
+
+/**
+ * Serializes V8 values straight to UTF-8 JSON, following the semantics
+ * of JSON.stringify
+ */
+class JsonEncoder
+{
+public:
+    enum Status {
+        ENCODE_OK,
+        // Not handled natively. Use JSON.stringify instead
+        ENCODE_FALLBACK,
+        // A JavaScript exception was thrown during conversion
+        ENCODE_ERROR,
+        // The value is omitted by JSON (undefined, functions). Internal
+        ENCODE_SKIP
+    };
+
+    static Status encode(Handle<Value> input, std::string &out);
+
+private:
+    static const int maxDepth = 256;
+    static Status writeValue(Handle<Value> v, Handle<Value> holderKey,
+                             std::string &out, int depth);
+    static void writeString(Handle<String> s, std::string &out);
+    static void writeNumber(double d, std::string &out);
+};
+
+}
+
+#endif
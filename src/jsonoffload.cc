@@ -0,0 +1,102 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase_impl.h"
+
+namespace Couchnode
+{
+
+JsonDecodeJob::JsonDecodeJob(Cookie *c, const lcb_get_resp_t *resp,
+                             uint32_t f, Handle<Object> p)
+    : cookie(c),
+      key((const char *)resp->v.v0.key, resp->v.v0.nkey),
+      bytes((const char *)resp->v.v0.bytes, resp->v.v0.nbytes),
+      flags(f), status(JsonTape::PARSE_UNSUPPORTED)
+{
+    payload = Persistent<Object>::New(p);
+    req.data = this;
+}
+
+JsonDecodeJob::~JsonDecodeJob()
+{
+    payload.Dispose();
+    payload.Clear();
+}
+
+void JsonDecodeJob::schedule(Cookie *cookie, const lcb_get_resp_t *resp,
+                             uint32_t flags, Handle<Object> payload)
+{
+    JsonDecodeJob *job = new JsonDecodeJob(cookie, resp, flags, payload);
+    uv_queue_work(uv_default_loop(), &job->req, work, after);
+}
+
+void JsonDecodeJob::work(uv_work_t *req)
+{
+    // No V8 calls from here
+    JsonDecodeJob *job = reinterpret_cast<JsonDecodeJob *>(req->data);
+
+    // Only scheduled for JSON, so the bit is set here only if it was
+    // already found to mean compression when the response arrived
+    if (job->flags & ValueFormat::COMPRESSED) {
+        std::string out;
+        if (!Snappy::uncompress(job->bytes.data(), job->bytes.size(), out)) {
+            job->status = JsonTape::PARSE_INVALID;
+            return;
+        }
+        job->bytes.swap(out);
+        job->flags &= ~ValueFormat::COMPRESSED;
+    }
+
+    job->status = job->tape.parse(job->bytes.data(), job->bytes.size());
+}
+
+Handle<Value> JsonDecodeJob::getValue()
+{
+    switch (status) {
+    case JsonTape::PARSE_OK:
+        return tape.materialize();
+    case JsonTape::PARSE_INVALID:
+        // Corrupt compressed data is returned as is, too
+        return ValueFormat::decode(bytes.data(), bytes.size(),
+                                   ValueFormat::RAW);
+    default:
+        // Left to JSON.parse, or to decompression if that failed
+        return ValueFormat::decode(bytes.data(), bytes.size(), flags);
+    }
+}
+
+#if NODE_VERSION_AT_LEAST(0, 10, 0)
+void JsonDecodeJob::after(uv_work_t *req, int)
+#else
+void JsonDecodeJob::after(uv_work_t *req)
+#endif
+{
+    HandleScope scope;
+    JsonDecodeJob *job = reinterpret_cast<JsonDecodeJob *>(req->data);
+
+    Handle<Value> keyObj = String::New(job->key.data(), job->key.size());
+    ResponseInfo ri(LCB_SUCCESS, keyObj);
+    ri.key = job->key.data();
+    ri.nkey = job->key.size();
+    ri.payload = job->payload;
+    ri.setField(NameMap::VALUE, job->getValue());
+
+    job->cookie->markProgress(ri);
+    delete job;
+}
+
+}
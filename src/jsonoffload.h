@@ -0,0 +1,69 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef COUCHNODE_JSONOFFLOAD_H
+#define COUCHNODE_JSONOFFLOAD_H 1
+#ifndef COUCHBASE_H
+#error "include couchbase_impl.h first"
+#endif
+
+#include <string>
+#include "node_version.h"
+
+namespace Couchnode
+{
+
+/**
+ * Decodes one large JSON value on the libuv threadpool. The value is
+ * copied out of the libcouchbase buffer, decompressed if need be and
+ * parsed into a JsonTape by a worker thread, and only materialized into
+ * V8 objects back on the main thread, after which the key is reported to
+ * its cookie as usual.
+ */
+class JsonDecodeJob
+{
+public:
+    static void schedule(Cookie *cookie, const lcb_get_resp_t *resp,
+                         uint32_t flags, Handle<Object> payload);
+
+private:
+    JsonDecodeJob(Cookie *cookie, const lcb_get_resp_t *resp,
+                  uint32_t flags, Handle<Object> payload);
+    ~JsonDecodeJob();
+
+    static void work(uv_work_t *req);
+    // libuv only passes a status to the completion callback since 0.10
+#if NODE_VERSION_AT_LEAST(0, 10, 0)
+    static void after(uv_work_t *req, int);
+#else
+    static void after(uv_work_t *req);
+#endif
+    Handle<Value> getValue();
+
+    uv_work_t req;
+    Cookie *cookie;
+    std::string key;
+    // Must outlive the tape, whose strings point into it
+    std::string bytes;
+    uint32_t flags;
+    JsonTape tape;
+    JsonTape::Status status;
+    Persistent<Object> payload;
+};
+
+}
+
+#endif
@@ -61,6 +61,10 @@ void NameMap::initialize()
     install("method", HTTP_METHOD);
     install("lcb_http_type", HTTP_TYPE);
     install("status", HTTP_STATUS);
+    install("stream", HTTP_STREAM);
+    install("include_docs", HTTP_INCLUDE_DOCS);
+    install("id", VIEW_ROW_ID);
+    install("doc", VIEW_ROW_DOC);
 
     install("json", FMT_JSON);
     install("raw", FMT_RAW);
@@ -70,6 +74,12 @@ void NameMap::initialize()
     install("raw", GET_RAW);
 
     install("hashkey", HASHKEY);
+    install("toJSON", TO_JSON);
+
+    install("columnar", COLUMNAR);
+    install("keys", COL_KEYS);
+    install("values", COL_VALUES);
+    install("errors", COL_ERRORS);
 }
 
 void NameMap::install(const char *name, dict_t val)
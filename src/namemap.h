@@ -66,6 +66,10 @@ namespace Couchnode
             HTTP_METHOD,
             HTTP_TYPE,
             HTTP_STATUS,
+            HTTP_STREAM,
+            HTTP_INCLUDE_DOCS,
+            VIEW_ROW_ID,
+            VIEW_ROW_DOC,
 
             FMT_RAW,
             FMT_UTF8,
@@ -75,6 +79,12 @@ namespace Couchnode
             FMT_TYPE,
 
             HASHKEY,
+            TO_JSON,
+
+            COLUMNAR,
+            COL_KEYS,
+            COL_VALUES,
+            COL_ERRORS,
 
             MAX
         } dict_t;
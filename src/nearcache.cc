@@ -0,0 +1,255 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase_impl.h"
+#include <cstring>
+
+namespace Couchnode
+{
+
+extern "C" {
+    static void nearcache_close_cb(uv_handle_t *handle) {
+        delete handle;
+    }
+
+    static void nearcache_check_cb(uv_check_t *checker, int) {
+        reinterpret_cast<NearCache *>(checker->data)->flush();
+    }
+
+    static void nearcache_idle_cb(uv_idle_t *, int) {
+        // Only here to keep the loop from blocking while hits wait
+    }
+}
+
+NearCache::NearCache() : maxBytes(0), ttl(1000), nwrites(0)
+{
+    checker = new uv_check_t;
+    uv_check_init(uv_default_loop(), checker);
+    checker->data = this;
+
+    idler = new uv_idle_t;
+    uv_idle_init(uv_default_loop(), idler);
+    idler->data = this;
+}
+
+NearCache::~NearCache()
+{
+    uv_check_stop(checker);
+    uv_idle_stop(idler);
+    uv_close((uv_handle_t *)checker, nearcache_close_cb);
+    uv_close((uv_handle_t *)idler, nearcache_close_cb);
+}
+
+void NearCache::setMaxBytes(size_t val)
+{
+    maxBytes = val;
+    clear();
+}
+
+NearCache::Shard &NearCache::getShard(const char *key, size_t nkey)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    for (size_t ii = 0; ii < nkey; ii++) {
+        hash = (hash ^ (unsigned char)key[ii]) * 16777619U;
+    }
+    return shards[hash % NSHARDS];
+}
+
+void NearCache::erase(Shard &shard, EntryMap::iterator iter)
+{
+    shard.nbytes -= iter->second->size();
+    shard.lru.erase(iter->second);
+    shard.entries.erase(iter);
+}
+
+void NearCache::clear()
+{
+    for (unsigned int ii = 0; ii < NSHARDS; ii++) {
+        shards[ii].lru.clear();
+        shards[ii].entries.clear();
+        shards[ii].nbytes = 0;
+    }
+}
+
+bool NearCache::lookup(const char *key, size_t nkey, Hit &out)
+{
+    Shard &shard = getShard(key, nkey);
+    EntryMap::iterator iter = shard.entries.find(std::string(key, nkey));
+    if (iter == shard.entries.end()) {
+        stats.misses++;
+        return false;
+    }
+
+    Entry &entry = *iter->second;
+    if (entry.expires <= (uint64_t)uv_now(uv_default_loop())) {
+        erase(shard, iter);
+        stats.expired++;
+        stats.misses++;
+        return false;
+    }
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+    out.key = entry.key;
+    out.value = entry.value;
+    out.flags = entry.flags;
+    out.cas = entry.cas;
+    stats.hits++;
+    return true;
+}
+
+void NearCache::store(const lcb_get_resp_t *resp)
+{
+    const char *key = (const char *)resp->v.v0.key;
+    size_t nkey = resp->v.v0.nkey;
+    size_t budget = maxBytes / NSHARDS;
+    Shard &shard = getShard(key, nkey);
+    std::string skey(key, nkey);
+
+    EntryMap::iterator iter = shard.entries.find(skey);
+    if (iter != shard.entries.end()) {
+        erase(shard, iter);
+    }
+
+    // Fetched before a mutation still in flight, which may have changed it
+    if (shard.writes.count(skey)) {
+        return;
+    }
+
+    if (nkey + resp->v.v0.nbytes + ENTRY_OVERHEAD > budget) {
+        return;
+    }
+
+    shard.lru.push_front(Entry());
+    Entry &entry = shard.lru.front();
+    entry.key.assign(key, nkey);
+    entry.value.assign((const char *)resp->v.v0.bytes, resp->v.v0.nbytes);
+    entry.flags = resp->v.v0.flags;
+    entry.cas = resp->v.v0.cas;
+    entry.expires = uv_now(uv_default_loop()) + ttl;
+
+    shard.entries[entry.key] = shard.lru.begin();
+    shard.nbytes += entry.size();
+
+    while (shard.nbytes > budget) {
+        erase(shard, shard.entries.find(shard.lru.back().key));
+        stats.evictions++;
+    }
+}
+
+void NearCache::invalidate(const void *key, size_t nkey)
+{
+    Shard &shard = getShard((const char *)key, nkey);
+    EntryMap::iterator iter =
+            shard.entries.find(std::string((const char *)key, nkey));
+    if (iter != shard.entries.end()) {
+        erase(shard, iter);
+        stats.invalidations++;
+    }
+}
+
+void NearCache::beginWrite(const char *key, size_t nkey)
+{
+    invalidate(key, nkey);
+    getShard(key, nkey).writes[std::string(key, nkey)]++;
+    nwrites++;
+}
+
+void NearCache::endWrite(const void *key, size_t nkey)
+{
+    invalidate(key, nkey);
+    if (!nwrites) {
+        return;
+    }
+
+    Shard &shard = getShard((const char *)key, nkey);
+    WriteMap::iterator iter =
+            shard.writes.find(std::string((const char *)key, nkey));
+    if (iter == shard.writes.end()) {
+        return;
+    }
+
+    if (--iter->second == 0) {
+        shard.writes.erase(iter);
+    }
+    nwrites--;
+}
+
+size_t NearCache::getEntryCount() const
+{
+    size_t ret = 0;
+    for (unsigned int ii = 0; ii < NSHARDS; ii++) {
+        ret += shards[ii].entries.size();
+    }
+    return ret;
+}
+
+size_t NearCache::getBytes() const
+{
+    size_t ret = 0;
+    for (unsigned int ii = 0; ii < NSHARDS; ii++) {
+        ret += shards[ii].nbytes;
+    }
+    return ret;
+}
+
+void NearCache::deliver(Cookie *cookie, std::vector<Hit> &hits)
+{
+    if (hits.empty()) {
+        return;
+    }
+
+    for (unsigned int ii = 0; ii < hits.size(); ii++) {
+        pending.push_back(Delivery());
+        Delivery &cur = pending.back();
+        cur.cookie = cookie;
+        cur.hit.key.swap(hits[ii].key);
+        cur.hit.value.swap(hits[ii].value);
+        cur.hit.flags = hits[ii].flags;
+        cur.hit.cas = hits[ii].cas;
+    }
+    hits.clear();
+
+    uv_check_start(checker, nearcache_check_cb);
+    uv_idle_start(idler, nearcache_idle_cb);
+}
+
+void NearCache::flush()
+{
+    uv_check_stop(checker);
+    uv_idle_stop(idler);
+
+    // Callbacks may issue gets answered from the cache in turn
+    std::vector<Delivery> cur;
+    cur.swap(pending);
+
+    HandleScope scope;
+    for (unsigned int ii = 0; ii < cur.size(); ii++) {
+        const Hit &hit = cur[ii].hit;
+        lcb_get_resp_t resp;
+        memset(&resp, 0, sizeof(resp));
+        resp.v.v0.key = hit.key.data();
+        resp.v.v0.nkey = hit.key.size();
+        resp.v.v0.bytes = hit.value.data();
+        resp.v.v0.nbytes = hit.value.size();
+        resp.v.v0.flags = hit.flags;
+        resp.v.v0.cas = hit.cas;
+        cur[ii].cookie->onGetResponse(LCB_SUCCESS, &resp);
+    }
+}
+
+}
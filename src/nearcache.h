@@ -0,0 +1,160 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef COUCHNODE_NEARCACHE_H
+#define COUCHNODE_NEARCACHE_H 1
+#ifndef COUCHBASE_H
+#error "include couchbase_impl.h first"
+#endif
+
+#include <list>
+#include <string>
+
+namespace Couchnode
+{
+
+/**
+ * An in-process cache of the documents last retrieved by a connection,
+ * holding their encoded bytes with their flags and CAS. It is filled by
+ * the responses to gets and emptied of a key by the responses to this
+ * connection's own stores, removals and arithmetic on it. Changes made
+ * by other clients are only seen once an entry has expired.
+ *
+ * Entries are spread over several LRU lists by a hash of their key, each
+ * with an equal share of the byte budget, so that eviction only ever
+ * walks a small list.
+ *
+ * Gets answered from the cache never reach libcouchbase. Their responses
+ * are queued and delivered to the cookie once the current loop
+ * iteration is done, so that callbacks are never invoked synchronously.
+ */
+class NearCache
+{
+public:
+    struct Hit {
+        std::string key;
+        std::string value;
+        uint32_t flags;
+        lcb_cas_t cas;
+    };
+
+    struct Stats {
+        Stats() : hits(0), misses(0), expired(0), evictions(0),
+                  invalidations(0) {}
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t expired;
+        uint64_t evictions;
+        uint64_t invalidations;
+    };
+
+    NearCache();
+    ~NearCache();
+
+    bool isEnabled() const { return maxBytes != 0; }
+
+    // Total size of the entries, keys included. 0 disables the cache and
+    // drops its contents
+    size_t getMaxBytes() const { return maxBytes; }
+    void setMaxBytes(size_t val);
+
+    // Lifetime of an entry, in milliseconds
+    unsigned int getTtl() const { return ttl; }
+    void setTtl(unsigned int val) { ttl = val; }
+
+    // Returns false on a miss; expired entries are dropped
+    bool lookup(const char *key, size_t nkey, Hit &out);
+
+    void store(const lcb_get_resp_t *resp);
+    void invalidate(const void *key, size_t nkey);
+
+    // A mutation of the key was issued. Its entry is dropped, and the key
+    // is neither served nor stored until endWrite() is called as many
+    // times, so gets issued meanwhile see the server's ordering
+    void beginWrite(const char *key, size_t nkey);
+
+    // A mutation was answered or could not be scheduled. Also drops the
+    // entry for mutations issued while the cache was disabled
+    void endWrite(const void *key, size_t nkey);
+    bool hasPendingWrites() const { return nwrites != 0; }
+
+    // Queues the hits for delivery to the cookie, emptying the vector
+    void deliver(Cookie *cookie, std::vector<Hit> &hits);
+    void flush();
+
+    const Stats &getStats() const { return stats; }
+    void resetStats() { stats = Stats(); }
+    size_t getEntryCount() const;
+    size_t getBytes() const;
+
+private:
+    enum { NSHARDS = 16 };
+
+    // Bookkeeping, counted against the budget with the key and value
+    enum { ENTRY_OVERHEAD = 96 };
+
+    struct Entry {
+        std::string key;
+        std::string value;
+        uint32_t flags;
+        lcb_cas_t cas;
+        uint64_t expires;
+
+        size_t size() const {
+            return key.size() + value.size() + ENTRY_OVERHEAD;
+        }
+    };
+
+    typedef std::list<Entry> LruList;
+    typedef std::map<std::string, LruList::iterator> EntryMap;
+    typedef std::map<std::string, unsigned int> WriteMap;
+
+    struct Shard {
+        Shard() : nbytes(0) {}
+        // Most recently used first
+        LruList lru;
+        EntryMap entries;
+        size_t nbytes;
+        // Mutations in flight, by key
+        WriteMap writes;
+    };
+
+    struct Delivery {
+        Cookie *cookie;
+        Hit hit;
+    };
+
+    Shard &getShard(const char *key, size_t nkey);
+    void erase(Shard &shard, EntryMap::iterator iter);
+    void clear();
+
+    Shard shards[NSHARDS];
+    size_t maxBytes;
+    unsigned int ttl;
+    size_t nwrites;
+    Stats stats;
+
+    std::vector<Delivery> pending;
+    uv_check_t *checker;
+    uv_idle_t *idler;
+
+    // No copying
+    NearCache(NearCache&);
+};
+
+}
+
+#endif
@@ -29,29 +29,71 @@ bool ParamSlot::maybeSetFalse(Handle<Value> v)
     return false;
 }
 
-bool ParamSlot::parseAll(const Handle<Object> dict, ParamSlot **specs,
-                         size_t nspecs, CBExc &ex)
+bool OptionScan::read(const Handle<Value> value, CBExc &ex)
 {
-    if (dict.IsEmpty()) {
+    count = 0;
+
+    if (value.IsEmpty()) {
         return true; // no options
     }
 
-    if (!dict->IsObject()) {
-        if (dict->BooleanValue()) {
-            ex.eArguments("Value passed is not an object", dict);
+    if (!value->IsObject()) {
+        if (value->BooleanValue()) {
+            ex.eArguments("Value passed is not an object", value);
             return false;
         }
         return true;
     }
 
-    if (!dict->GetPropertyNames()->Length()) {
+    dict = value.As<Object>();
+    Handle<Array> propNames = dict->GetOwnPropertyNames();
+    count = propNames->Length();
+
+    if (count <= MAX_INLINE) {
+        for (unsigned int ii = 0; ii < count; ii++) {
+            names[ii] = propNames->Get(ii);
+        }
+    }
+    return true;
+}
+
+Handle<Value> OptionScan::find(const Handle<String> name) const
+{
+    if (count > MAX_INLINE) {
+        if (!dict->HasRealNamedProperty(name)) {
+            return Handle<Value>();
+        }
+        return dict->Get(name);
+    }
+
+    for (unsigned int ii = 0; ii < count; ii++) {
+        if (names[ii] == name) {
+            return dict->Get(name);
+        }
+    }
+    return Handle<Value>();
+}
+
+bool ParamSlot::parseAll(const Handle<Object> dict, ParamSlot **specs,
+                         size_t nspecs, CBExc &ex)
+{
+    OptionScan scan;
+    if (!scan.read(dict, ex)) {
+        return false;
+    }
+    return parseAll(scan, specs, nspecs, ex);
+}
+
+bool ParamSlot::parseAll(const OptionScan &scan, ParamSlot **specs,
+                         size_t nspecs, CBExc &ex)
+{
+    if (scan.isEmpty()) {
         return true;
     }
 
     for (unsigned int ii = 0; ii < nspecs; ii++ ) {
         ParamSlot *cur = specs[ii];
-        Handle<String> name = cur->getName();
-        Handle<Value> val = dict->GetRealNamedProperty(name);
+        Handle<Value> val = scan.find(cur->getName());
 
         if (val.IsEmpty()) {
             continue;
@@ -35,6 +35,33 @@ enum ParseStatus {
     PARSE_OPTION_FALSEVAL
 };
 
+/**
+ * The own properties of an options object, listed once so that the slots
+ * of any number of parsers can be matched against them. Property names
+ * and slot names are both interned symbols, so matching a slot is a
+ * pointer comparison per property, and properties no slot asks for are
+ * never read.
+ */
+class OptionScan
+{
+public:
+    enum { MAX_INLINE = 16 };
+
+    OptionScan() : count(0) {}
+
+    // An empty or false-ish value means there are no options
+    bool read(const Handle<Value> dict, CBExc &ex);
+    bool isEmpty() const { return count == 0; }
+
+    // Returns an empty handle if the property is not set
+    Handle<Value> find(const Handle<String> name) const;
+
+private:
+    Handle<Object> dict;
+    Handle<Value> names[MAX_INLINE];
+    unsigned int count;
+};
+
 struct ParamSlot {
     static ParseStatus validateNumber(const Handle<Value>, CBExc&);
     virtual ParseStatus parseValue(const Handle<Value>, CBExc&) = 0;
@@ -52,6 +79,7 @@ struct ParamSlot {
 
     ParseStatus status;
     static bool parseAll(const Handle<Object>, ParamSlot **, size_t, CBExc&);
+    static bool parseAll(const OptionScan&, ParamSlot **, size_t, CBExc&);
     bool maybeSetFalse(Handle<Value>);
     template <typename T>
     ParseStatus setNumber(Handle<Value> val, T& res) {
@@ -0,0 +1,54 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase_impl.h"
+
+namespace Couchnode
+{
+
+const std::vector<std::string> &RoutingTable::getServers(lcb_t instance)
+{
+    if (valid) {
+        return servers;
+    }
+
+    servers.clear();
+    const char * const *list = lcb_get_server_list(instance);
+    for (const char * const *cur = list; cur && *cur; cur++) {
+        servers.push_back(*cur);
+    }
+    valid = true;
+    return servers;
+}
+
+lcb_error_t RoutingTable::map(lcb_t instance, const char *key, size_t nkey,
+                              int *vbucket, int *server)
+{
+    struct lcb_cntl_vbinfo_st vbi;
+    memset(&vbi, 0, sizeof(vbi));
+    vbi.v.v0.key = key;
+    vbi.v.v0.nkey = nkey;
+
+    lcb_error_t err = lcb_cntl(instance, LCB_CNTL_GET, LCB_CNTL_VBMAP, &vbi);
+    if (err == LCB_SUCCESS) {
+        *vbucket = vbi.v.v0.vbucket;
+        *server = vbi.v.v0.server_index;
+    }
+    return err;
+}
+
+}
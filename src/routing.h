@@ -0,0 +1,59 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef COUCHNODE_ROUTING_H
+#define COUCHNODE_ROUTING_H 1
+#ifndef COUCHBASE_H
+#error "include couchbase_impl.h first"
+#endif
+
+namespace Couchnode
+{
+
+/**
+ * Maps keys to their vbucket and server for the current cluster
+ * configuration. The server table is fetched once per configuration and
+ * kept until the next one arrives; the generation number lets callers
+ * tell whether mappings they obtained earlier are still current.
+ */
+class RoutingTable
+{
+public:
+    RoutingTable() : generation(0), valid(false) {}
+
+    // Called whenever the cluster configuration changes
+    void invalidate() {
+        generation++;
+        valid = false;
+    }
+
+    unsigned int getGeneration() const { return generation; }
+
+    // Host names of the servers, indexed by server index
+    const std::vector<std::string> &getServers(lcb_t instance);
+
+    lcb_error_t map(lcb_t instance, const char *key, size_t nkey,
+                    int *vbucket, int *server);
+
+private:
+    unsigned int generation;
+    bool valid;
+    std::vector<std::string> servers;
+};
+
+}
+
+#endif
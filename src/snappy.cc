@@ -0,0 +1,244 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase_impl.h"
+#include <cstring>
+
+namespace Couchnode
+{
+
+static inline uint32_t load32(const char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hashBytes(uint32_t v, int shift)
+{
+    return (v * 0x1e35a7bd) >> shift;
+}
+
+static char *emitLiteral(char *op, const char *literal, size_t len)
+{
+    size_t n = len - 1;
+    if (n < 60) {
+        *op++ = (char)(n << 2);
+    } else {
+        // The length follows the tag, in 1 to 4 little-endian bytes
+        char *tag = op++;
+        int count = 0;
+        while (n > 0) {
+            *op++ = (char)(n & 0xff);
+            n >>= 8;
+            count++;
+        }
+        *tag = (char)((59 + count) << 2);
+    }
+
+    memcpy(op, literal, len);
+    return op + len;
+}
+
+// Emits a single copy of 4 to 64 bytes
+static char *emitShortCopy(char *op, size_t offset, size_t len)
+{
+    if (len < 12 && offset < 2048) {
+        *op++ = (char)(1 + ((len - 4) << 2) + ((offset >> 8) << 5));
+        *op++ = (char)(offset & 0xff);
+    } else {
+        *op++ = (char)(2 + ((len - 1) << 2));
+        *op++ = (char)(offset & 0xff);
+        *op++ = (char)(offset >> 8);
+    }
+    return op;
+}
+
+static char *emitCopy(char *op, size_t offset, size_t len)
+{
+    while (len >= 68) {
+        op = emitShortCopy(op, offset, 64);
+        len -= 64;
+    }
+
+    // Keep the remainder at 4 bytes or more
+    if (len > 64) {
+        op = emitShortCopy(op, offset, 60);
+        len -= 60;
+    }
+    return emitShortCopy(op, offset, len);
+}
+
+char *Snappy::compressBlock(const char *in, size_t n, char *op,
+                            uint16_t *table)
+{
+    const int shift = 32 - tableBits;
+    const char *end = in + n;
+    const char *literal = in;
+    const char *ip = in + 1;
+
+    memset(table, 0, sizeof(*table) << tableBits);
+
+    // Every position tried must have 4 readable bytes
+    while (n >= 4 && ip <= end - 4) {
+        uint32_t cur = load32(ip);
+        uint32_t h = hashBytes(cur, shift);
+        const char *candidate = in + table[h];
+        table[h] = (uint16_t)(ip - in);
+
+        if (load32(candidate) != cur) {
+            // Step faster through data which does not compress
+            ip += 1 + ((ip - literal) >> 5);
+            continue;
+        }
+
+        if (ip > literal) {
+            op = emitLiteral(op, literal, ip - literal);
+        }
+
+        const char *match = candidate + 4;
+        const char *pos = ip + 4;
+        while (pos < end && *match == *pos) {
+            match++;
+            pos++;
+        }
+
+        op = emitCopy(op, ip - candidate, pos - ip);
+        ip = literal = pos;
+    }
+
+    if (literal < end) {
+        op = emitLiteral(op, literal, end - literal);
+    }
+    return op;
+}
+
+size_t Snappy::compress(const char *in, size_t n, char *out)
+{
+    char *op = out;
+
+    // Uncompressed length, as a varint
+    size_t len = n;
+    while (len >= 0x80) {
+        *op++ = (char)(len | 0x80);
+        len >>= 7;
+    }
+    *op++ = (char)len;
+
+    // Offsets never reach outside the current block, so they always fit
+    // in the hash table and in two bytes
+    uint16_t table[1 << tableBits];
+    for (size_t ii = 0; ii < n; ii += blockSize) {
+        size_t blockLen = n - ii < blockSize ? n - ii : blockSize;
+        op = compressBlock(in + ii, blockLen, op, table);
+    }
+    return op - out;
+}
+
+bool Snappy::uncompress(const char *input, size_t n, std::string &out)
+{
+    const unsigned char *ip = (const unsigned char *)input;
+    const unsigned char *end = ip + n;
+
+    uint64_t len = 0;
+    for (int shift = 0;; shift += 7) {
+        if (ip == end || shift > 28) {
+            return false;
+        }
+        len |= (uint64_t)(*ip & 0x7f) << shift;
+        if (!(*ip++ & 0x80)) {
+            break;
+        }
+    }
+
+    // No element expands more than 64 / 3 times; anything claiming more
+    // is not Snappy data, and must not make us allocate
+    if (len > (uint64_t)n * 22) {
+        return false;
+    }
+
+    out.resize(len);
+    size_t pos = 0;
+
+    while (ip < end) {
+        unsigned char tag = *ip++;
+        size_t count;
+        size_t offset;
+
+        if ((tag & 3) == 0) {
+            count = tag >> 2;
+            if (count >= 60) {
+                size_t nbytes = count - 59;
+                if ((size_t)(end - ip) < nbytes) {
+                    return false;
+                }
+                count = 0;
+                for (size_t ii = 0; ii < nbytes; ii++) {
+                    count |= (size_t)ip[ii] << (8 * ii);
+                }
+                ip += nbytes;
+            }
+            count++;
+
+            if ((size_t)(end - ip) < count || len - pos < count) {
+                return false;
+            }
+            memcpy(&out[pos], ip, count);
+            ip += count;
+            pos += count;
+            continue;
+        }
+
+        if ((tag & 3) == 1) {
+            if (ip == end) {
+                return false;
+            }
+            count = ((tag >> 2) & 7) + 4;
+            offset = ((size_t)(tag >> 5) << 8) | *ip++;
+
+        } else if ((tag & 3) == 2) {
+            if (end - ip < 2) {
+                return false;
+            }
+            count = (tag >> 2) + 1;
+            offset = ip[0] | ((size_t)ip[1] << 8);
+            ip += 2;
+
+        } else {
+            if (end - ip < 4) {
+                return false;
+            }
+            count = (tag >> 2) + 1;
+            offset = ip[0] | ((size_t)ip[1] << 8) |
+                    ((size_t)ip[2] << 16) | ((size_t)ip[3] << 24);
+            ip += 4;
+        }
+
+        if (offset == 0 || offset > pos || len - pos < count) {
+            return false;
+        }
+
+        // Copies may overlap their own output, so go byte by byte
+        for (size_t ii = 0; ii < count; ii++, pos++) {
+            out[pos] = out[pos - offset];
+        }
+    }
+
+    return pos == len;
+}
+
+}
@@ -0,0 +1,60 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef COUCHNODE_SNAPPY_H
+#define COUCHNODE_SNAPPY_H 1
+#ifndef COUCHBASE_H
+#error "include couchbase_impl.h first"
+#endif
+
+#include <string>
+
+namespace Couchnode
+{
+
+/**
+ * A self-contained implementation of the Snappy raw format (without the
+ * framing format), so that values can be exchanged with any other Snappy
+ * implementation. The compressor favours simplicity over ratio; any
+ * valid Snappy input is accepted by the decompressor.
+ *
+ * Neither function touches V8, so both may run on any thread.
+ */
+class Snappy
+{
+public:
+    static size_t maxCompressedLength(size_t n) {
+        return 32 + n + n / 6;
+    }
+
+    // Compresses n bytes into out, which must hold at least
+    // maxCompressedLength(n) bytes. Returns the compressed size
+    static size_t compress(const char *in, size_t n, char *out);
+
+    // Returns false if the input is not valid Snappy data
+    static bool uncompress(const char *in, size_t n, std::string &out);
+
+private:
+    static const size_t blockSize = 65536;
+    static const int tableBits = 14;
+
+    static char *compressBlock(const char *in, size_t n, char *out,
+                               uint16_t *table);
+};
+
+}
+
+#endif
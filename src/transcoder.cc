@@ -0,0 +1,165 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase_impl.h"
+#include "node_buffer.h"
+namespace Couchnode {
+
+Transcoder::Registry Transcoder::registry;
+
+bool Transcoder::isReserved(uint32_t flags)
+{
+    switch (flags) {
+    case ValueFormat::JSON:
+    case ValueFormat::UTF16:
+    case ValueFormat::RAW:
+    case ValueFormat::UTF8:
+    case ValueFormat::AUTO:
+        return true;
+    default:
+        break;
+    }
+
+    // Formats are carried around as ValueFormat::Spec, so must fit in it
+    return (flags & ValueFormat::COMPRESSED) || flags > MAX_FLAGS;
+}
+
+void Transcoder::add(uint32_t flags, Transcoder *tc)
+{
+    remove(flags);
+    registry[flags] = tc;
+}
+
+void Transcoder::remove(uint32_t flags)
+{
+    Registry::iterator iter = registry.find(flags);
+    if (iter != registry.end()) {
+        delete iter->second;
+        registry.erase(iter);
+    }
+}
+
+Handle<Value> Transcoder::Register(const Arguments &args)
+{
+    HandleScope scope;
+    CBExc ex;
+
+    if (args.Length() != 2) {
+        return ex.eArguments("Need flags and transcoder").throwV8();
+    }
+
+    if (!args[0]->IsUint32() || isReserved(args[0]->Uint32Value())) {
+        return ex.eArguments("Invalid transcoder flags", args[0]).throwV8();
+    }
+    uint32_t flags = args[0]->Uint32Value();
+
+    if (!args[1]->BooleanValue()) {
+        remove(flags);
+        return scope.Close(True());
+    }
+
+    if (!args[1]->IsObject()) {
+        return ex.eArguments("Transcoder must be an object", args[1]).throwV8();
+    }
+
+    Handle<Object> obj = args[1].As<Object>();
+    Handle<Value> encoder = obj->Get(String::NewSymbol("encode"));
+    Handle<Value> decoder = obj->Get(String::NewSymbol("decode"));
+    if (!encoder->IsFunction() || !decoder->IsFunction()) {
+        return ex.eArguments("Transcoder needs encode and decode functions",
+                             args[1]).throwV8();
+    }
+
+    add(flags, new JsTranscoder(encoder.As<Function>(),
+                                decoder.As<Function>()));
+    return scope.Close(True());
+}
+
+JsTranscoder::JsTranscoder(Handle<Function> enc, Handle<Function> dec)
+{
+    encoder = Persistent<Function>::New(enc);
+    decoder = Persistent<Function>::New(dec);
+}
+
+JsTranscoder::~JsTranscoder()
+{
+    encoder.Dispose();
+    decoder.Dispose();
+}
+
+bool JsTranscoder::encode(Handle<Value> input, BufferList &buf,
+                          char **k, size_t *n, CBExc &ex)
+{
+    HandleScope scope;
+    v8::TryCatch try_catch;
+
+    Handle<Value> ret = encoder->Call(
+            v8::Context::GetEntered()->Global(), 1, &input);
+    if (try_catch.HasCaught()) {
+        ex.eArguments("Couldn't encode value", try_catch.Exception());
+        return false;
+    }
+
+    if (node::Buffer::HasInstance(ret)) {
+        *n = node::Buffer::Length(ret.As<Object>());
+        if (*n == 0) {
+            *k = const_cast<char *>("");
+            return true;
+        }
+
+        // The Buffer is not referenced once this returns
+        if (!(*k = buf.getBuffer(*n))) {
+            ex.eMemory();
+            return false;
+        }
+        memcpy(*k, node::Buffer::Data(ret.As<Object>()), *n);
+        return true;
+
+    } else if (ret->IsString()) {
+        Handle<String> s = ret.As<String>();
+        if (s->Length() == 0) {
+            *k = const_cast<char *>("");
+            *n = 0;
+            return true;
+        }
+
+        if (!ValueFormat::writeUtf8(s, buf, k, n)) {
+            ex.eMemory();
+            return false;
+        }
+        return true;
+    }
+
+    ex.eArguments("Transcoder must return a Buffer or a string", ret);
+    return false;
+}
+
+Handle<Value> JsTranscoder::decode(const char *bytes, size_t n)
+{
+    HandleScope scope;
+    v8::TryCatch try_catch;
+
+    Handle<Value> raw = ValueFormat::decode(bytes, n, ValueFormat::RAW);
+    Handle<Value> ret = decoder->Call(
+            v8::Context::GetEntered()->Global(), 1, &raw);
+    if (try_catch.HasCaught()) {
+        return scope.Close(raw);
+    }
+    return scope.Close(ret);
+}
+
+}
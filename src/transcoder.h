@@ -0,0 +1,115 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef COUCHNODE_TRANSCODER_H
+#define COUCHNODE_TRANSCODER_H 1
+#ifndef COUCHBASE_H
+#error "include couchbase_impl.h first"
+#endif
+
+namespace Couchnode
+{
+
+/**
+ * A codec for a custom value format, identified by the flags stored with
+ * its values. Once registered, it is used by ValueFormat::encode when a
+ * store names its flags as the format, and by ValueFormat::decode for
+ * any value retrieved with them, so a native codec reads and writes the
+ * libcouchbase buffers directly.
+ *
+ * Native codecs compiled into the module register themselves with add();
+ * JavaScript ones are wrapped in a JsTranscoder by registerTranscoder().
+ */
+class Transcoder
+{
+public:
+    // The highest flags value which can be registered
+    enum { MAX_FLAGS = 0x7fffff };
+
+    virtual ~Transcoder() {}
+
+    /**
+     * Encodes a value
+     * @param input the value to encode
+     * @param buf the BufferList to allocate the output from
+     * @param k set to the encoded data
+     * @param n set to the size of the encoded data
+     * @param ex error if this function fails
+     * @return true if successful, false otherwise
+     */
+    virtual bool encode(Handle<Value> input, BufferList &buf,
+                        char **k, size_t *n, CBExc &ex) = 0;
+
+    /**
+     * Decodes a value. The input is only valid for the duration of the
+     * call
+     */
+    virtual Handle<Value> decode(const char *bytes, size_t n) = 0;
+
+    /**
+     * Whether a flags value is used by the built-in formats, or cannot be
+     * used as a format at all
+     */
+    static bool isReserved(uint32_t flags);
+
+    /**
+     * Registers a transcoder, taking ownership of it. Any transcoder
+     * previously registered for the same flags is deleted
+     */
+    static void add(uint32_t flags, Transcoder *tc);
+    static void remove(uint32_t flags);
+
+    // Returns NULL if no transcoder is registered for the flags
+    static Transcoder *find(uint32_t flags) {
+        if (registry.empty()) {
+            return NULL;
+        }
+        Registry::const_iterator iter = registry.find(flags);
+        return iter == registry.end() ? NULL : iter->second;
+    }
+
+    // registerTranscoder(flags, { encode: ..., decode: ... } | null)
+    static Handle<Value> Register(const Arguments &args);
+
+private:
+    typedef std::map<uint32_t, Transcoder*> Registry;
+    static Registry registry;
+};
+
+/**
+ * A transcoder implemented by a pair of JavaScript functions.
+ * encode(value) returns a Buffer or a string, which is stored as UTF-8;
+ * decode(buffer) returns the value. A value which fails to decode is
+ * returned as a Buffer, as for invalid JSON.
+ */
+class JsTranscoder : public Transcoder
+{
+public:
+    JsTranscoder(Handle<Function> encoder, Handle<Function> decoder);
+    virtual ~JsTranscoder();
+
+    virtual bool encode(Handle<Value> input, BufferList &buf,
+                        char **k, size_t *n, CBExc &ex);
+    virtual Handle<Value> decode(const char *bytes, size_t n);
+
+private:
+    Persistent<Function> encoder;
+    Persistent<Function> decoder;
+};
+
+}
+
+#endif
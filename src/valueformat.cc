@@ -17,10 +17,56 @@
 
 #include "couchbase_impl.h"
 #include "node_buffer.h"
+#include "node_version.h"
 namespace Couchnode {
 Persistent<Function> ValueFormat::jsonParse;
 Persistent<Function> ValueFormat::jsonStringify;
 
+// Decoding is left to V8 by default: JSON.parse builds objects internally
+// and is generally faster than constructing them through the API
+unsigned int ValueFormat::nativeJson = ValueFormat::NATIVE_JSON_ENCODE;
+size_t ValueFormat::offloadThreshold = 0;
+size_t ValueFormat::compressThreshold = 0;
+bool ValueFormat::decompress = false;
+
+/**
+ * A string for the native JSON encoder to write to. The encoder calls
+ * back into JavaScript (toJSON and getters), which may store another
+ * document and so re-enter ValueFormat::encode; each level of nesting
+ * thus gets its own string. The strings are kept for reuse so that their
+ * capacity is not allocated anew for each document, unless they have
+ * grown unusually large.
+ */
+class JsonScratch
+{
+public:
+    JsonScratch() {
+        if (depth == strings.size()) {
+            strings.push_back(new std::string);
+        }
+        str = strings[depth++];
+        str->clear();
+    }
+
+    ~JsonScratch() {
+        if (str->capacity() > maxKeptCapacity) {
+            std::string().swap(*str);
+        }
+        depth--;
+    }
+
+    std::string &get() { return *str; }
+
+private:
+    static const size_t maxKeptCapacity = 1024 * 1024;
+    static std::vector<std::string *> strings;
+    static unsigned int depth;
+    std::string *str;
+};
+
+std::vector<std::string *> JsonScratch::strings;
+unsigned int JsonScratch::depth = 0;
+
 void ValueFormat::initialize()
 {
     HandleScope scope;
@@ -41,6 +87,14 @@ void ValueFormat::initialize()
 Handle<Value> ValueFormat::decode(const char *bytes, size_t n,
                                   uint32_t flags)
 {
+    if (isCompressed(flags)) {
+        std::string out;
+        if (!Snappy::uncompress(bytes, n, out)) {
+            return decode(bytes, n, RAW);
+        }
+        return decode(out.data(), out.size(), flags & ~COMPRESSED);
+    }
+
     if (flags == UTF8) {
         return String::New(bytes, n);
 
@@ -50,6 +104,22 @@ Handle<Value> ValueFormat::decode(const char *bytes, size_t n,
         return buf->handle_;
 
     } else if (flags == JSON) {
+        if (nativeJson & NATIVE_JSON_DECODE) {
+            static JsonTape tape;
+            JsonTape::Status status = tape.parse(bytes, n);
+
+            if (status == JsonTape::PARSE_OK) {
+                Handle<Value> ret = tape.materialize();
+                tape.clear();
+                return ret;
+
+            } else if (status == JsonTape::PARSE_INVALID) {
+                tape.clear();
+                return decode(bytes, n, RAW);
+            }
+            tape.clear();
+        }
+
         Handle<Value> s = decode(bytes, n, UTF8);
         v8::TryCatch try_catch;
         Handle<Value> ret = jsonParse->Call(
@@ -60,6 +130,11 @@ Handle<Value> ValueFormat::decode(const char *bytes, size_t n,
 
         return ret;
     } else {
+        Transcoder *tc = Transcoder::find(flags);
+        if (tc) {
+            return tc->decode(bytes, n);
+        }
+
         // unrecognized format
         return decode(bytes, n, RAW);
     }
@@ -67,6 +142,73 @@ Handle<Value> ValueFormat::decode(const char *bytes, size_t n,
     return Handle<Value>();
 }
 
+bool ValueFormat::compress(BufferList &buf, uint32_t *flags,
+                           char **k, size_t *n)
+{
+    if (!compressThreshold || *n < compressThreshold) {
+        return false;
+    }
+
+    size_t capacity = Snappy::maxCompressedLength(*n);
+    char *out = buf.getBuffer(capacity);
+    if (!out) {
+        return false;
+    }
+
+    // Not worth the cost of decompressing below 1/8 saved
+    size_t nout = Snappy::compress(*k, *n, out);
+    if (nout > *n - *n / 8) {
+        buf.trimLast(out, 0, capacity);
+        return false;
+    }
+
+    buf.trimLast(out, nout, capacity);
+    *k = out;
+    *n = nout;
+    *flags |= COMPRESSED;
+    return true;
+}
+
+bool ValueFormat::writeUtf8(Handle<String> s, BufferList &buf,
+                            char **k, size_t *n, bool addNul)
+{
+    int len = s->Length();
+    size_t extra = addNul ? 1 : 0;
+
+#if NODE_VERSION_AT_LEAST(0, 10, 0)
+    // ASCII is its own UTF-8 encoding, and its size is already known
+    if (!s->MayContainNonAscii()) {
+        *n = len;
+        if (!(*k = buf.getBuffer(len + extra))) {
+            return false;
+        }
+        s->WriteAscii(*k, 0, len, String::NO_NULL_TERMINATION);
+        if (addNul) {
+            (*k)[len] = '\0';
+        }
+        return true;
+    }
+#endif
+
+    size_t capacity;
+    if (len > maxOneShotLength) {
+        capacity = s->Utf8Length();
+    } else {
+        capacity = (size_t)len * 3;
+    }
+
+    if (!(*k = buf.getBuffer(capacity + extra))) {
+        return false;
+    }
+
+    *n = s->WriteUtf8(*k, capacity, NULL, String::NO_NULL_TERMINATION);
+    buf.trimLast(*k, *n + extra, capacity + extra);
+    if (addNul) {
+        (*k)[*n] = '\0';
+    }
+    return true;
+}
+
 static bool returnEmptyString(char **k, size_t *n)
 {
     if (*n == 0) {
@@ -77,13 +219,20 @@ static bool returnEmptyString(char **k, size_t *n)
 }
 
 bool ValueFormat::encodeNodeBuffer(Handle<Object> input, BufferList &buf,
-                                   char **k, size_t *n, CBExc &ex)
+                                   char **k, size_t *n, CBExc &ex,
+                                   bool *borrowed)
 {
     *n = node::Buffer::Length(input);
-    if (!*n) {
+    if (returnEmptyString(k, n)) {
+        return true;
+    }
 
+    if (borrowed) {
+        *k = node::Buffer::Data(input);
+        *borrowed = true;
+        return true;
     }
-    // TODO: Check if we're connected or not..
+
     *k = buf.getBuffer(*n);
     if (!*k) {
         ex.eMemory();
@@ -121,7 +270,8 @@ bool ValueFormat::encode(Handle<Value> input,
                          uint32_t *flags,
                          char **k,
                          size_t *n,
-                         CBExc &ex)
+                         CBExc &ex,
+                         bool *borrowed)
 {
     if (spec == INVALID) {
         ex.eArguments("Passed an invalid specifier");
@@ -142,29 +292,23 @@ bool ValueFormat::encode(Handle<Value> input,
         }
 
         s = input.As<String>();
-        *n = s->Utf8Length();
+        *n = s->Length();
 
         if (returnEmptyString(k, n)) {
             return true;
         }
 
-        *k = buf.getBuffer(*n);
-        if (!*k) {
+        if (!writeUtf8(s, buf, k, n)) {
             ex.eMemory();
             return false;
         }
-
-        size_t nw = s->WriteUtf8(*k, *n, NULL, String::NO_NULL_TERMINATION);
-        if (nw != *n) {
-            ex.eArguments("Incomplete conversion", s);
-            return false;
-        }
         return true;
 
     } else if (spec == RAW) {
         if (node::Buffer::HasInstance(input)) {
             *flags = RAW;
-            return encodeNodeBuffer(input.As<Object>(), buf, k, n, ex);
+            return encodeNodeBuffer(input.As<Object>(), buf, k, n, ex,
+                                    borrowed);
 
         } else {
             bool ret = encode(input, UTF8, buf, flags, k, n, ex);
@@ -174,6 +318,37 @@ bool ValueFormat::encode(Handle<Value> input,
 
     } else if (spec == JSON) {
         v8::TryCatch try_catch;
+
+        if (nativeJson & NATIVE_JSON_ENCODE) {
+            // The size of the output is only known once the input has
+            // been walked, and BufferList hands out fixed size blocks, so
+            // the document is copied once it is complete
+            JsonScratch scratch;
+            std::string &out = scratch.get();
+            JsonEncoder::Status status = JsonEncoder::encode(input, out);
+
+            if (status == JsonEncoder::ENCODE_ERROR) {
+                ex.eArguments("Couldn't convert to JSON",
+                              try_catch.Exception());
+                return false;
+
+            } else if (status == JsonEncoder::ENCODE_OK) {
+                *flags = JSON;
+                *n = out.size();
+                if (returnEmptyString(k, n)) {
+                    return true;
+                }
+
+                *k = buf.getBuffer(*n);
+                if (!*k) {
+                    ex.eMemory();
+                    return false;
+                }
+                memcpy(*k, out.data(), *n);
+                return true;
+            }
+        }
+
         Handle<Value> ret = jsonStringify->Call(
                 v8::Context::GetEntered()->Global(), 1, &input);
 
@@ -190,8 +365,14 @@ bool ValueFormat::encode(Handle<Value> input,
         return true;
 
     } else {
-        ex.eArguments("Can't parse spec");
-        return false;
+        Transcoder *tc = Transcoder::find(spec);
+        if (!tc) {
+            ex.eArguments("Can't parse spec");
+            return false;
+        }
+
+        *flags = spec;
+        return tc->encode(input, buf, k, n, ex);
     }
 }
 
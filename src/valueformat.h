@@ -34,10 +34,68 @@ public:
         AUTO = 0x777777
     };
 
+    // Set in the flags, alongside the format, of values stored in the
+    // Snappy raw format. This is our own convention rather than a shared
+    // one: the PHP 1.x client uses the same bit for zlib
+    // (COUCHBASE_COMPRESSION_ZLIB), so it is only honoured when values
+    // are decompressed at all, see isCompressed()
+    enum {
+        COMPRESSED = 0x20
+    };
+
+    // Bits for nativeJson
+    enum {
+        NATIVE_JSON_ENCODE = 0x01,
+        NATIVE_JSON_DECODE = 0x02
+    };
+
     static void initialize();
     static Persistent<Function> jsonParse;
     static Persistent<Function> jsonStringify;
 
+    /**
+     * Which directions use the built-in codec in jsoncodec.h rather than
+     * calling out to the JSON global. Values the native codec does not
+     * handle fall back to the JavaScript implementation regardless.
+     */
+    static unsigned int nativeJson;
+
+    /**
+     * JSON values of at least this many bytes are decoded on the libuv
+     * threadpool instead of in the libcouchbase callback. 0 disables this
+     */
+    static size_t offloadThreshold;
+
+    /**
+     * Stored values of at least this many bytes are compressed, if that
+     * makes them meaningfully smaller. 0 disables compression
+     */
+    static size_t compressThreshold;
+
+    /**
+     * Decompresses retrieved values flagged COMPRESSED even while
+     * compressThreshold is 0, for readers of data written by a process
+     * which compresses
+     */
+    static bool decompress;
+
+    /**
+     * Whether a retrieved value with these flags is to be decompressed.
+     * Unless compression is enabled or decompress is set, the bit is
+     * taken to belong to another client and the value is left alone
+     */
+    static bool isCompressed(uint32_t flags) {
+        return (flags & COMPRESSED) && (compressThreshold || decompress);
+    }
+
+    /**
+     * Compresses an encoded value in place if it is large enough and
+     * compresses well, setting COMPRESSED in the flags
+     * @return true if the value was compressed
+     */
+    static bool compress(BufferList &buf, uint32_t *flags,
+                         char **k, size_t *n);
+
     static Spec toSpec(Handle<Value> input, CBExc& ex) {
         if (input.IsEmpty()) {
             return AUTO;
@@ -71,6 +129,10 @@ public:
             case RAW:
                 return RAW;
             default:
+                if (i->IsUint32() && Transcoder::find(i->Uint32Value())) {
+                    // A custom format, named by its flags
+                    return static_cast<Spec>(i->Uint32Value());
+                }
                 ex.eArguments("Unknown format specifier", input);
                 return INVALID;
             }
@@ -83,7 +145,8 @@ public:
     }
 
     /**
-     * Decodes a value based on the flags
+     * Decodes a value based on the flags. Flags without a built-in format
+     * are looked up among the registered Transcoders
      * @param bytes the input buffer to decode
      * @param n the size of the input buffer
      * @param flags format specifier
@@ -99,6 +162,9 @@ public:
      * @param k pointer to be set to the encoded data
      * @param n size of encoded data
      * @param ex error if this function fails
+     * @param borrowed if not NULL, node::Buffer input is not copied; rather
+     * k is set to the Buffer's own storage and this is set to true. The
+     * caller must then keep the Buffer alive for as long as k is in use
      * @return true if successful, false otherwise
      */
     static bool encode(Handle<Value> input,
@@ -107,21 +173,33 @@ public:
                        uint32_t *flags,
                        char **k,
                        size_t *n,
-                       CBExc& ex);
+                       CBExc& ex,
+                       bool *borrowed = NULL);
 
-    static bool writeUtf8(Handle<Value> input,
+    /**
+     * Converts a string to UTF-8, walking it only once where possible
+     * @param s the string to convert. Must not be empty
+     * @param buf the BufferList to allocate the output from
+     * @param k set to the output
+     * @param n set to the size of the output, excluding any terminator
+     * @param addNul whether to NUL-terminate the output
+     * @return false if the output could not be allocated
+     */
+    static bool writeUtf8(Handle<String> s,
                           BufferList &buf,
-                          char **k, size_t n,
-                          CBExc& ex,
+                          char **k, size_t *n,
                           bool addNul=false);
 
 private:
+    // Longer strings have their exact size computed first rather than
+    // reserving the worst case of three bytes per character
+    static const int maxOneShotLength = 16384;
 
     // static instance
     ValueFormat();
     static inline Spec getAutoSpec(Handle<Value>);
     static inline bool encodeNodeBuffer(Handle<Object>, BufferList&,
-                                        char **, size_t*, CBExc&);
+                                        char **, size_t*, CBExc&, bool*);
 };
 
 }
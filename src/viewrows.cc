@@ -0,0 +1,151 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase_impl.h"
+#include <cctype>
+
+namespace Couchnode
+{
+
+void ViewRowParser::feed(const char *data, size_t n)
+{
+    compact();
+    buf.append(data, n);
+    scan();
+}
+
+void ViewRowParser::scan()
+{
+    for (; scanPos < buf.size(); scanPos++) {
+        char c = buf[scanPos];
+
+        if (inString) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                inString = false;
+                if (state == S_META && depth == 1) {
+                    keyIsRows = key == "rows";
+                }
+            } else if (state == S_META && depth == 1 && key.size() < 5) {
+                key += c;
+            }
+
+            if (state == S_META) {
+                meta += c;
+            }
+            continue;
+        }
+
+        switch (state) {
+        case S_META:
+            meta += c;
+            if (c == '"') {
+                inString = true;
+                key.clear();
+            } else if (c == '{' || c == '[') {
+                depth++;
+                if (c == '[' && depth == 2 && keyIsRows) {
+                    state = S_ROWS;
+                }
+                keyIsRows = false;
+            } else if (c == '}' || c == ']') {
+                depth--;
+                keyIsRows = false;
+            } else if (c != ':' && !isspace((unsigned char)c)) {
+                keyIsRows = false;
+            }
+            break;
+
+        case S_ROWS:
+            if (c == '{' || c == '[') {
+                state = S_ROW;
+                rowStart = scanPos;
+                depth++;
+            } else if (c == ']') {
+                state = S_META;
+                meta += c;
+                depth--;
+            }
+            // Separators between rows are dropped
+            break;
+
+        case S_ROW:
+            if (c == '"') {
+                inString = true;
+            } else if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 2) {
+                    rows.push_back(std::make_pair(rowStart, scanPos + 1));
+                    state = S_ROWS;
+                }
+            }
+            break;
+        }
+    }
+}
+
+size_t ViewRowParser::takeRows(std::string &out, size_t max)
+{
+    size_t count = 0;
+    if (rows.empty()) {
+        return 0;
+    }
+
+    out += '[';
+    while (count < max && !rows.empty()) {
+        if (count) {
+            out += ',';
+        }
+        out.append(buf, rows.front().first,
+                   rows.front().second - rows.front().first);
+        rows.pop_front();
+        count++;
+    }
+    out += ']';
+    return count;
+}
+
+void ViewRowParser::compact()
+{
+    // Everything before the first row still needed has been consumed
+    size_t keepFrom;
+    if (!rows.empty()) {
+        keepFrom = rows.front().first;
+    } else if (state == S_ROW) {
+        keepFrom = rowStart;
+    } else {
+        keepFrom = scanPos;
+    }
+
+    if (!keepFrom) {
+        return;
+    }
+
+    buf.erase(0, keepFrom);
+    scanPos -= keepFrom;
+    rowStart -= keepFrom < rowStart ? keepFrom : rowStart;
+    for (size_t ii = 0; ii < rows.size(); ii++) {
+        rows[ii].first -= keepFrom;
+        rows[ii].second -= keepFrom;
+    }
+}
+
+}
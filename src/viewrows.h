@@ -0,0 +1,90 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef COUCHNODE_VIEWROWS_H
+#define COUCHNODE_VIEWROWS_H 1
+#ifndef COUCHBASE_H
+#error "include couchbase_impl.h first"
+#endif
+
+#include <deque>
+#include <string>
+
+namespace Couchnode
+{
+
+/**
+ * Splits a view response into its rows as it arrives, without parsing
+ * the rows themselves. Response data may be fed in chunks of any size.
+ *
+ * The elements of the top-level "rows" array are queued as raw JSON
+ * text; everything else in the response is kept as the "meta" document,
+ * in which the rows array is left empty. Other responses (e.g. errors)
+ * end up entirely in the meta document.
+ */
+class ViewRowParser
+{
+public:
+    ViewRowParser()
+        : state(S_META), depth(0), inString(false), escaped(false),
+          keyIsRows(false), scanPos(0), rowStart(0) {}
+
+    void feed(const char *data, size_t n);
+
+    size_t getRowCount() const { return rows.size(); }
+
+    /**
+     * Remove up to max queued rows, appending them to out as a JSON array.
+     * Returns the number of rows taken; nothing is written if there are
+     * none
+     */
+    size_t takeRows(std::string &out, size_t max);
+
+    const std::string &getMeta() const { return meta; }
+
+private:
+    enum State {
+        // Outside of the rows array
+        S_META,
+        // Inside the rows array, between rows
+        S_ROWS,
+        // Inside a row
+        S_ROW
+    };
+
+    void scan();
+    void compact();
+
+    State state;
+    int depth;
+    bool inString;
+    bool escaped;
+
+    // The current top-level key, and whether it is "rows"
+    std::string key;
+    bool keyIsRows;
+
+    std::string buf;
+    size_t scanPos;
+    size_t rowStart;
+    // Offsets of complete rows within buf
+    std::deque<std::pair<size_t, size_t> > rows;
+    std::string meta;
+};
+
+}
+
+#endif
@@ -17,6 +17,90 @@ describe('#ctl', function() {
     }));
   });
 
+  it('should map several keys at once', function(done) {
+    var kv = H.genMultiKeys(10, "ctlVbMulti");
+    var keys = Object.keys(kv);
+    cb.setMulti(kv, null, H.okCallback(function() {
+      var res = cb.vbMappingMulti(keys);
+      assert.equal(res.vbuckets.length, keys.length);
+      assert.equal(res.servers.length, keys.length);
+      assert.equal(typeof res.generation, 'number');
+
+      keys.forEach(function(key, i) {
+        var single = cb.vbMappingInfo(key);
+        assert.equal(res.vbuckets[i], single[0]);
+        assert.equal(res.servers[i], single[1]);
+      });
+
+      var groups = cb.groupKeysByServer(keys);
+      var total = 0;
+      for (var host in groups) {
+        assert.notEqual(res.hosts.indexOf(host), -1);
+        total += groups[host].length;
+      }
+      assert.equal(total, keys.length);
+      done();
+    }));
+  });
+
+  it('should report buffer pool usage', function(done) {
+    var kv = H.genMultiKeys(20, "ctlBufpool");
+    cb.setMulti(kv, null, H.okCallback(function() {
+      var stats = cb.bufferPoolStats;
+      assert.equal(typeof stats, 'object');
+      assert(stats.hits + stats.misses > 0);
+      assert(stats.resident >= stats.idle);
+      done();
+    }));
+  });
+
+  it('should bound the queue of pending operations', function(done) {
+    var client = H.newClient();
+    var key = H.genKey("ctlPending");
+    var nfailed = 0;
+
+    client.pendingLimit = 2;
+    client.pendingFailFast = true;
+
+    client.on('drain', function() {
+      assert.equal(nfailed, 1);
+      assert.equal(client.pendingStats.depth, 0);
+      client.shutdown();
+      done();
+    });
+
+    for (var i = 0; i < 3; i++) {
+      client.set(key, "value", function(err) {
+        if (err) {
+          assert.equal(err.code, couchbase.errors.queueFull);
+          nfailed++;
+        }
+      });
+    }
+    assert.equal(client.pendingStats.depth, 2);
+    assert(client.pendingStats.bytes > 0);
+  });
+
+  it('should record operation latencies', function(done) {
+    var key = H.genKey("ctlLatency");
+    cb.latencyTracking = true;
+
+    cb.set(key, "value", H.okCallback(function() {
+      cb.get(key, H.okCallback(function() {
+        var stats = cb.latencyStats(true);
+        cb.latencyTracking = false;
+
+        assert.equal(stats.set.count, 1);
+        assert.equal(stats.get.count, 1);
+        assert(stats.get.p50 > 0);
+        assert(stats.get.p50 <= stats.get.p99);
+        assert(stats.get.max >= stats.get.min);
+        assert.deepEqual(cb.latencyStats(), {});
+        done();
+      }));
+    }));
+  });
+
   it('should return proper client version', function(done) {
     var vresult = cb.clientVersion;
     assert.equal(typeof vresult, 'object');
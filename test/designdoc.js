@@ -406,6 +406,87 @@ describe('#design documents', function() {
     ]);
   });
 
+  it('should stream view rows', function(done) {
+    this.timeout(10000);
+
+    // Relies on the "querytest" design document from the tests above
+    var q = cb.view("querytest", "simple", { stale: false });
+    var stream = q.stream({ startkey: 0, limit: 500 });
+    var rows = [];
+    var nbatches = 0;
+
+    stream.on('rows', function(batch) {
+      assert(Array.isArray(batch));
+      rows = rows.concat(batch);
+
+      // Rows must not be delivered while paused
+      if (nbatches++ === 0) {
+        var seen = rows.length;
+        stream.pause();
+        setTimeout(function() {
+          assert.equal(rows.length, seen);
+          stream.resume();
+        }, 100);
+      }
+    });
+
+    stream.on('error', function(err) {
+      assert(!err, "stream failed: " + err);
+    });
+
+    stream.on('end', function(meta) {
+      assert(!stream.paused);
+      assert.equal(rows.length, 500);
+      assert.equal(rows[0].key, 0);
+      assert(rows[1].key > rows[0].key);
+      assert(meta.total_rows >= 500);
+      done();
+    });
+  });
+
+  it('should fetch documents for streamed view rows', function(done) {
+    this.timeout(10000);
+
+    // Relies on the "querytest" design document from the tests above
+    var q = cb.view("querytest", "simple", { stale: false });
+    q.query({ startkey: 0, limit: 200, include_docs: true },
+            function(err, rows) {
+      assert(!err, "include_docs query failed: " + err);
+      assert.equal(rows.length, 200);
+      rows.forEach(function(row) {
+        assert(row.doc, "missing doc for " + row.id);
+        assert.equal(row.doc.meta.id, row.id);
+        assert.equal(row.doc.json.type, 10);
+        assert.equal(Number(row.id.slice(6)), row.key);
+      });
+      done();
+    });
+  });
+
+  it('should pass partial view errors along with the rows', function(done) {
+    var ViewStream = require('../lib/viewQuery.js').ViewStream;
+    var stream = new ViewStream();
+
+    stream.on('error', function(err) {
+      assert(false, "partial errors are not fatal: " + err);
+    });
+    stream.on('end', function(meta, errors) {
+      assert.equal(meta.total_rows, 10);
+      assert.equal(errors.length, 1);
+      assert.equal(errors[0].code, 9999);
+      assert.equal(errors[0].reason, "timeout");
+      done();
+    });
+    stream._onEnd(null, {
+      status: 200,
+      data: JSON.stringify({
+        total_rows: 10,
+        rows: [],
+        errors: [{ from: "127.0.0.1:9500", reason: "timeout" }]
+      })
+    });
+  });
+
   it('should successfully see new keys?', function(done) {
     this.timeout(10000);
 
@@ -37,4 +37,21 @@ describe('#durability', function() {
     }));
   });
 
+  it('should successfully setMulti with durability requirements',
+      function(done) {
+    var kv = {};
+    kv[H.genKey("endure-multi1")] = { value: "value1" };
+    kv[H.genKey("endure-multi2")] = { value: "value2" };
+
+    cb.setMulti(kv, {persist_to:1, replicate_to:0}, function(err, meta) {
+      assert(!err, "Failed to store with durability requirements");
+      for (var key in kv) {
+        assert(key in meta);
+        assert(!meta[key].error);
+        assert('cas' in meta[key]);
+      }
+      done();
+    });
+  });
+
 });
@@ -65,6 +65,131 @@ describe('#get/set', function() {
     });
   });
 
+  it('should allow reading and replacing decoded values', function(done) {
+    var key = H.genKey("set-lazy");
+
+    cb.set(key, {foo: "bar"}, H.okCallback(function(){
+      cb.lazyValues = true;
+      cb.get(key, H.okCallback(function(result){
+        cb.lazyValues = false;
+        assert(result.cas);
+        assert.equal(result.value.foo, "bar");
+        assert.strictEqual(result.value, result.value);
+        assert.deepEqual(Object.keys(result).sort(), ['cas', 'flags', 'value']);
+
+        result.value = 42;
+        assert.equal(result.value, 42);
+        done();
+      }));
+    }));
+  });
+
+  it('should return fields in the same order for every value', function(done) {
+    var key = H.genKey("set-shape");
+    var key2 = H.genKey("set-shape2");
+
+    cb.set(key, {foo: "bar"}, H.okCallback(function(){
+      cb.set(key2, "bar", H.okCallback(function(meta){
+        assert.deepEqual(Object.keys(meta), ['cas']);
+        cb.get(key, H.okCallback(function(json){
+          cb.get(key2, H.okCallback(function(str){
+            assert.deepEqual(Object.keys(json), ['cas', 'flags', 'value']);
+            assert.deepEqual(Object.keys(str), Object.keys(json));
+            done();
+          }));
+        }));
+      }));
+    }));
+  });
+
+  it('should share errors for missing keys when asked to', function(done) {
+    var key = H.genKey("get-shared-miss");
+
+    cb.sharedErrors = true;
+    cb.remove(key, function(){
+      cb.get(key, function(err1){
+        cb.get(key, function(err2){
+          cb.sharedErrors = false;
+          assert.equal(err1.code, couchbase.errors.keyNotFound);
+          assert.strictEqual(err1, err2);
+          assert(Object.isFrozen(err1));
+
+          cb.get(key, function(err3){
+            assert.equal(err3.code, couchbase.errors.keyNotFound);
+            assert.notStrictEqual(err3, err1);
+            done();
+          });
+        });
+      });
+    });
+  });
+
+  it('should answer repeated gets from the near cache', function(done) {
+    var key = H.genKey("get-nearcache");
+
+    cb.nearCacheSize = 1024 * 1024;
+    cb.nearCacheStats(true);
+    cb.set(key, "first", H.okCallback(function(){
+      cb.get(key, H.okCallback(function(res1){
+        cb.get(key, H.okCallback(function(res2){
+          assert.equal(res1.value, "first");
+          assert.equal(res2.value, "first");
+          assert.deepEqual(res2.cas, res1.cas);
+          assert.equal(cb.nearCacheStats().hits, 1);
+
+          // Our own store drops the entry
+          cb.set(key, "second", H.okCallback(function(){
+            cb.get(key, H.okCallback(function(res3){
+              cb.nearCacheSize = 0;
+              assert.equal(res3.value, "second");
+              assert.equal(cb.nearCacheStats(true).hits, 1);
+              done();
+            }));
+          }));
+        }));
+      }));
+    }));
+  });
+
+  it('should not answer a get from the near cache past a store', function(done) {
+    var key = H.genKey("get-nearcache-pipelined");
+
+    cb.nearCacheSize = 1024 * 1024;
+    cb.set(key, "first", H.okCallback(function(){
+      cb.get(key, H.okCallback(function(){
+        // Issued back to back, the get must not see the cached value
+        var stored = false;
+        cb.set(key, "second", H.okCallback(function(){
+          stored = true;
+        }));
+        cb.get(key, H.okCallback(function(res){
+          cb.nearCacheSize = 0;
+          assert(stored);
+          assert.equal(res.value, "second");
+          done();
+        }));
+      }));
+    }));
+  });
+
+  it('should not cache gets with a hashkey', function(done) {
+    var key = H.genKey("get-nearcache-hashkey");
+    var opts = { hashkey: key + "_hashkey" };
+
+    cb.nearCacheSize = 1024 * 1024;
+    cb.nearCacheStats(true);
+    cb.set(key, "bar", opts, H.okCallback(function(){
+      cb.get(key, opts, H.okCallback(function(){
+        cb.get(key, opts, H.okCallback(function(res){
+          cb.nearCacheSize = 0;
+          assert.equal(res.value, "bar");
+          assert.equal(cb.nearCacheStats(true).hits, 0);
+          done();
+        }));
+      }));
+    }));
+  });
+
   it('should round-trip Unicode values', function(done) {
     var key = H.genKey("set-unicode");
     var value = ['☆'];
@@ -102,6 +227,112 @@ describe('#get/set', function() {
     }));
   });
 
+  it('should encode and decode JSON natively', function(done) {
+    var value = {
+      str: "q\"\\\n\u0001☆", num: [0, -1, 1.5, 1e21, 1e-7, 123456789012],
+      nested: {a: [null, true, false, undefined], b: undefined},
+      date: new Date(0)
+    };
+    var key = H.genKey("set-native-json");
+
+    var oldMode = cb.nativeJson;
+    cb.nativeJson = 3;
+    cb.set(key, value, H.okCallback(function(){
+      cb.get(key, { format: 'raw' }, H.okCallback(function(result){
+        assert.equal(result.value.toString(), JSON.stringify(value));
+        cb.get(key, H.okCallback(function(result){
+          cb.nativeJson = oldMode;
+          assert.deepEqual(result.value, JSON.parse(JSON.stringify(value)));
+          done();
+        }));
+      }));
+    }));
+  });
+
+  it('should decode large JSON values off the main thread', function(done) {
+    var value = { items: [] };
+    for (var i = 0; i < 1000; i++) {
+      value.items.push({ id: i, name: "item" + i });
+    }
+    var key = H.genKey("get-json-offload");
+
+    var oldThreshold = cb.jsonOffloadThreshold;
+    cb.jsonOffloadThreshold = 1024;
+    cb.set(key, value, H.okCallback(function(){
+      cb.getMulti([key], null, H.okCallback(function(meta){
+        cb.jsonOffloadThreshold = oldThreshold;
+        assert.deepEqual(meta[key].value, value);
+        assert('cas' in meta[key]);
+        done();
+      }));
+    }));
+  });
+
+  it('should use registered transcoders', function(done) {
+    var key = H.genKey("set-transcoder");
+    var flags = 0x100;
+
+    couchbase.registerTranscoder(flags, {
+      encode: function(value) {
+        return value.join(",");
+      },
+      decode: function(buf) {
+        return buf.toString().split(",");
+      }
+    });
+
+    cb.set(key, ["a", "b", "c"], { format: flags }, H.okCallback(function(){
+      cb.get(key, { format: couchbase.format.utf8 }, H.okCallback(function(raw){
+        assert.equal(raw.value, "a,b,c");
+        cb.get(key, H.okCallback(function(result){
+          assert.equal(result.flags, flags);
+          assert.deepEqual(result.value, ["a", "b", "c"]);
+          couchbase.registerTranscoder(flags, null);
+          done();
+        }));
+      }));
+    }));
+  });
+
+  it('should compress large values transparently', function(done) {
+    var value = { items: [] };
+    for (var i = 0; i < 1000; i++) {
+      value.items.push({ id: i, name: "item" });
+    }
+    var key = H.genKey("set-compressed");
+
+    var oldThreshold = cb.compressionThreshold;
+    cb.compressionThreshold = 1024;
+    cb.set(key, value, H.okCallback(function(){
+      cb.compressionThreshold = oldThreshold;
+      cb.decompression = true;
+      cb.get(key, H.okCallback(function(result){
+        cb.decompression = false;
+        assert.equal(result.flags & 0x20, 0x20);
+        assert.deepEqual(result.value, value);
+        done();
+      }));
+    }));
+  });
+
+  it('should leave values flagged by other clients alone', function(done) {
+    // As written by the PHP 1.x client with zlib compression
+    var buf = new Buffer([0x78, 0x9c, 0x03, 0x00]);
+    var key = H.genKey("set-foreign-compressed");
+
+    assert.equal(cb.compressionThreshold, 0);
+    assert.equal(cb.decompression, false);
+    cb.set(key, buf, { flags: 0x20 | couchbase.format.raw },
+        H.okCallback(function(){
+      cb.get(key, H.okCallback(function(result){
+        assert.equal(result.flags, 0x20 | couchbase.format.raw);
+        assert(Buffer.isBuffer(result.value));
+        assert.deepEqual(result.value, buf);
+        done();
+      }));
+    }));
+  });
+
   it('should handle setting unencodable values', function(done) {
     var value = [1,2,3,4];
     var key = H.genKey("set-utf8-unconvertible");
@@ -128,6 +359,45 @@ describe('#get/set', function() {
     }));
   });
 
+  it('should copy Buffers unless asked to borrow them', function(done) {
+    var buf = new Buffer([0, 1, 2]);
+    var key = H.genKey("set-buffer-copy");
+
+    cb.set(key, buf, H.okCallback(function(){
+      cb.get(key, H.okCallback(function(meta){
+        assert.deepEqual(meta.value, new Buffer([0, 1, 2]));
+        done();
+      }));
+    }));
+    // Reusing the Buffer right away must not affect the stored value
+    buf.fill(9);
+  });
+
+  it('should store a document whose toJSON stores another', function(done) {
+    var outerKey = H.genKey("set-tojson-outer");
+    var innerKey = H.genKey("set-tojson-inner");
+    var remaining = 2;
+
+    function check() {
+      if (--remaining) {
+        return;
+      }
+      cb.getMulti([outerKey, innerKey], null, H.okCallback(function(meta){
+        assert.deepEqual(meta[outerKey].value, {outer: "value"});
+        assert.deepEqual(meta[innerKey].value, {inner: true});
+        done();
+      }));
+    }
+
+    var value = {
+      toJSON: function() {
+        cb.set(innerKey, {inner: true}, H.okCallback(check));
+        return {outer: "value"};
+      }
+    };
+    cb.set(outerKey, value, H.okCallback(check));
+  });
+
   it('should allow overriding of flags', function(done) {
     var value = {val:"value"};
     var key = H.genKey("set-flags-override");
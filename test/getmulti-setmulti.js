@@ -69,4 +69,137 @@ describe('#getMulti/setMulti', function() {
     });
   });
 
+  it('should preserve ordering when coalescing', function(done) {
+    var kv = H.genMultiKeys(20, "multiget-coalesce");
+    var keys = Object.keys(kv);
+    var remaining = keys.length * 3;
+
+    cb.coalesce = true;
+    function checkDone() {
+      if (--remaining === 0) {
+        cb.coalesce = false;
+        done();
+      }
+    }
+
+    keys.forEach(function(k) {
+      cb.set(k, kv[k].value, H.okCallback(checkDone));
+    });
+    keys.forEach(function(k) {
+      cb.get(k, H.okCallback(function(result) {
+        assert.equal(result.value, kv[k].value);
+        checkDone();
+      }));
+      cb.remove(k, H.okCallback(checkDone));
+    });
+  });
+
+  it('should deliver batched callbacks', function(done) {
+    var kv = H.genMultiKeys(20, "multiget-cbbatch");
+    var keys = Object.keys(kv);
+    var remaining = keys.length;
+
+    cb.callbackBatching = true;
+    cb.setMulti(kv, null, H.okCallback(function() {
+      keys.forEach(function(k) {
+        cb.get(k, H.okCallback(function(result) {
+          assert.equal(result.value, kv[k].value);
+          if (--remaining === 0) {
+            cb.callbackBatching = false;
+            done();
+          }
+        }));
+      });
+    }));
+  });
+
+  it('should fetch a key being fetched only once', function(done) {
+    var kv = H.genMultiKeys(5, "multiget-dedup");
+    var keys = Object.keys(kv);
+    var remaining = 2;
+
+    cb.setMulti(kv, null, H.okCallback(function() {
+      var before = cb.getsDeduplicated;
+      cb.getDeduplication = true;
+
+      function check(meta) {
+        keys.forEach(function(k) {
+          assert.equal(meta[k].value, kv[k].value);
+        });
+        if (--remaining === 0) {
+          // The repeated keys of both calls waited for the first fetch
+          assert.equal(cb.getsDeduplicated - before, keys.length * 2);
+          done();
+        }
+      }
+
+      cb.getMulti(keys.concat(keys), null, H.okCallback(check));
+      cb.getMulti(keys, null, H.okCallback(check));
+      cb.getDeduplication = false;
+    }));
+  });
+
+  it('should not share a fetch issued before a store', function(done) {
+    var key = H.genKey("get-dedup-pipelined");
+    var remaining = 2;
+
+    cb.set(key, "first", H.okCallback(function() {
+      cb.getDeduplication = true;
+
+      cb.get(key, H.okCallback(function(res) {
+        assert.equal(res.value, "first");
+        if (--remaining === 0) {
+          done();
+        }
+      }));
+
+      // Issued back to back, the last get must see the store
+      var stored = false;
+      cb.set(key, "second", H.okCallback(function() {
+        stored = true;
+      }));
+      cb.get(key, H.okCallback(function(res) {
+        assert(stored);
+        assert.equal(res.value, "second");
+        if (--remaining === 0) {
+          done();
+        }
+      }));
+      cb.getDeduplication = false;
+    }));
+  });
+
+  it('should return columnar results', function(done) {
+    var kv = H.genMultiKeys(10, "multiget-columnar");
+    var badKey = H.genKey("multiget-columnar-missing");
+    var keys = Object.keys(kv).concat([badKey]);
+
+    cb.setMulti(kv, null, H.okCallback(function(setResults) {
+      cb.getMulti(keys, { columnar: true }, function(err, res) {
+        assert.strictEqual(err.code, couchbase.errors.checkResults);
+        assert.equal(res.keys.length, keys.length);
+        assert.equal(res.flags.length, keys.length);
+        assert.equal(res.cas.length, keys.length * 8);
+
+        for (var i = 0; i < res.keys.length; i++) {
+          var k = res.keys[i];
+          if (k === badKey) {
+            assert.strictEqual(res.errors[i].code,
+                               couchbase.errors.keyNotFound);
+            continue;
+          }
+          assert(!res.errors[i]);
+          assert.equal(res.values[i], kv[k].value);
+        }
+
+        // CAS slices are accepted wherever a CAS is expected
+        var ix = res.keys.indexOf(keys[0]);
+        var cas = res.cas.slice(ix * 8, ix * 8 + 8);
+        cb.replace(keys[0], "updated", { cas: cas }, H.okCallback(function() {
+          done();
+        }));
+      });
+    }));
+  });
+
 });
@@ -0,0 +1,61 @@
+var assert = require('assert');
+var H = require('../test_harness.js');
+var couchbase = require('../lib/couchbase.js');
+
+describe('#pool', function() {
+
+  it('should spread operations over its connections', function(done) {
+    var pool = H.newPool({ poolSize: 2, dispatch: 'round-robin' },
+                         function(err) {
+      assert(!err, "Failed to connect the pool");
+
+      var kv = H.genMultiKeys(10, "pool");
+      pool.setMulti(kv, {}, H.okCallback(function() {
+        pool.getMulti(Object.keys(kv), {}, H.okCallback(function(meta) {
+          for (var k in kv) {
+            assert.equal(meta[k].value, kv[k].value);
+          }
+
+          var stats = pool.poolStats();
+          assert.equal(stats.connections.length, 2);
+          assert.equal(stats.connections[0].dispatched, 1);
+          assert.equal(stats.connections[1].dispatched, 1);
+          // The operation is complete once its callback has returned
+          process.nextTick(function() {
+            assert.equal(pool.outstanding, 0);
+            pool.shutdown();
+            done();
+          });
+        }));
+      }));
+    });
+  });
+
+  it('should apply settings to every connection', function(done) {
+    var pool = H.newPool({ poolSize: 2 }, function(err) {
+      assert(!err, "Failed to connect the pool");
+
+      pool.operationTimeout = 12345;
+      pool.connections.forEach(function(conn) {
+        assert.equal(conn.operationTimeout, 12345);
+      });
+      pool.shutdown();
+      done();
+    });
+  });
+
+  it('should count outstanding operations', function(done) {
+    var cb = H.newClient();
+    var key = H.genKey("outstanding");
+
+    cb.set(key, "value", H.okCallback(function() {
+      process.nextTick(function() {
+        assert.equal(cb.outstanding, 0);
+        cb.shutdown();
+        done();
+      });
+    }));
+    assert.equal(cb.outstanding, 1);
+  });
+
+});
@@ -26,4 +26,22 @@ describe('#prepend/append', function() {
     });
   });
 
-});
\ No newline at end of file
+  it('should not compress appended fragments', function(done) {
+    var key = H.genKey("append-compressed");
+    var fragment = new Array(2049).join("a");
+
+    var oldThreshold = cb.compressionThreshold;
+    cb.set(key, "base", H.okCallback(function(){
+      cb.compressionThreshold = 1024;
+      cb.append(key, fragment, H.okCallback(function(){
+        cb.get(key, H.okCallback(function(result){
+          cb.compressionThreshold = oldThreshold;
+          assert.equal(result.flags & 0x20, 0);
+          assert.equal(result.value, "base" + fragment);
+          done();
+        }));
+      }));
+    }));
+  });
+
+});
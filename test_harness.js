@@ -26,6 +26,17 @@ Harness.prototype.newClient = function(callback) {
   return new couchbase.Connection(config, callback);
 };
 
+Harness.prototype.newPool = function(options, callback) {
+  var poolConfig = {};
+  for (var k in config) {
+    poolConfig[k] = config[k];
+  }
+  for (var k in options) {
+    poolConfig[k] = options[k];
+  }
+  return new couchbase.ConnectionPool(poolConfig, callback);
+};
+
 Harness.prototype.genKey = function(prefix) {
   if (!prefix) {
     prefix = "generic";